@@ -0,0 +1,130 @@
+#include "alternatives.hpp"
+
+#include <algorithm>
+#include <set>
+
+namespace mapapp {
+std::vector<pathfind_result>
+alternative_routes(std::stop_token token, const osm_graph &graph, id_t start,
+                   id_t end, alternative_workspace &workspace,
+                   const alternative_options &options) {
+  using index_t = osm_graph::index_t;
+  constexpr auto no_node = shortest_path_tree::no_parent;
+  std::vector<pathfind_result> routes;
+
+  auto &forward = workspace.forward;
+  auto &backward = workspace.backward;
+  if (!graph.may_reach(start, end)) {
+    return routes;
+  }
+  auto stretch = 1.0 + options.max_stretch;
+  grow_shortest_path_tree(
+      token, graph, start,
+      {.target = static_cast<index_t>(end), .target_stretch = stretch},
+      forward);
+  if (!forward.complete || !forward.reached(end)) {
+    return routes;
+  }
+  const auto shortest = forward.distance[end];
+  grow_shortest_path_tree(token, graph, end,
+                          {.budget = shortest * stretch, .reverse = true},
+                          backward);
+  if (!backward.complete) {
+    return routes;
+  }
+
+  // an arc u -> v lies on a plateau if it is in both trees. forward settling
+  // order visits u before v, backward settling order v before u.
+  auto &plateau_start = workspace.plateau_start;
+  auto &plateau_end = workspace.plateau_end;
+  plateau_start.resize(graph.nodes.size());
+  plateau_end.resize(graph.nodes.size());
+  for (auto v : forward.settled) {
+    auto u = forward.parent[v];
+    if (backward.reached(v)) {
+      plateau_start[v] = u != no_node && backward.reached(u) &&
+                                 backward.parent[u] == v
+                             ? plateau_start[u]
+                             : v;
+    }
+  }
+  for (auto u : backward.settled) {
+    auto v = backward.parent[u];
+    if (forward.reached(u)) {
+      plateau_end[u] = v != no_node && forward.reached(v) &&
+                               forward.parent[v] == u
+                           ? plateau_end[v]
+                           : u;
+    }
+  }
+
+  struct candidate {
+    index_t via;
+    double length, plateau;
+  };
+  std::vector<candidate> candidates;
+  const auto root = static_cast<index_t>(start);
+  for (auto v : forward.settled) {
+    if (!backward.reached(v) || plateau_start[v] != v) {
+      continue;
+    }
+    auto length = forward.distance[v] + backward.distance[v];
+    auto plateau =
+        forward.distance[plateau_end[v]] - forward.distance[v];
+    if (length <= shortest * stretch &&
+        (v == root || plateau >= shortest * options.min_plateau)) {
+      candidates.push_back({v, length, plateau});
+    }
+  }
+  // short via paths with long plateaus first. the via path through `start`
+  // is the shortest path (its plateau may be split by ties) and always leads.
+  std::sort(candidates.begin(), candidates.end(),
+            [](const auto &a, const auto &b) {
+              return a.length - a.plateau < b.length - b.plateau;
+            });
+  std::stable_partition(candidates.begin(), candidates.end(),
+                        [&](const auto &c) { return c.via == root; });
+
+  std::set<std::pair<index_t, index_t>> used_arcs;
+  for (const auto &c : candidates) {
+    if (routes.size() > options.max_alternatives || token.stop_requested()) {
+      break;
+    }
+
+    // (node, weight of the arc into it)
+    std::vector<std::pair<index_t, double>> path;
+    for (auto v = c.via; v != no_node; v = forward.parent[v]) {
+      auto u = forward.parent[v];
+      path.emplace_back(v, u == no_node ? 0.0
+                                        : forward.distance[v] -
+                                              forward.distance[u]);
+    }
+    std::reverse(path.begin(), path.end());
+    for (auto u = c.via; u != static_cast<index_t>(end);) {
+      auto v = backward.parent[u];
+      path.emplace_back(v, backward.distance[u] - backward.distance[v]);
+      u = v;
+    }
+
+    double shared = 0.0;
+    for (std::size_t i = 1; i < path.size(); ++i) {
+      if (used_arcs.contains({path[i - 1].first, path[i].first})) {
+        shared += path[i].second;
+      }
+    }
+    if (!routes.empty() && shared > shortest * options.max_sharing) {
+      continue;
+    }
+
+    auto &route = routes.emplace_back();
+    route.distance = c.length;
+    for (std::size_t i = path.size(); i-- > 0;) {
+      route.path.push_back(path[i].first);
+      if (i > 0) {
+        used_arcs.emplace(path[i - 1].first, path[i].first);
+      }
+    }
+  }
+  return routes;
+}
+} // namespace mapapp
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "pathfind.hpp"
+#include <stop_token>
+#include <vector>
+
+namespace mapapp {
+struct alternative_options {
+  std::size_t max_alternatives = 2;
+  // an alternative may be at most (1 + max_stretch) times the shortest path
+  double max_stretch = 0.25;
+  // at most this fraction of the shortest distance may be shared with the
+  // routes picked before it
+  double max_sharing = 0.8;
+  // the plateau (the part of a via path that is shortest from both ends) has
+  // to cover this fraction of the shortest distance, which keeps detours
+  // locally optimal
+  double min_plateau = 0.2;
+};
+
+// reused between queries so that only the reached parts are reset
+struct alternative_workspace {
+  shortest_path_tree forward, backward;
+  std::vector<osm_graph::index_t> plateau_start, plateau_end;
+};
+
+// plateau method: a forward tree from `start` and a backward tree from `end`,
+// both bounded by the stretch, are intersected; every plateau gives a via
+// path. the shortest path comes first, followed by the admissible
+// alternatives. paths go from end to start.
+std::vector<pathfind_result>
+alternative_routes(std::stop_token token, const osm_graph &graph, id_t start,
+                   id_t end, alternative_workspace &workspace,
+                   const alternative_options &options = {});
+} // namespace mapapp
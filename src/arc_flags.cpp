@@ -0,0 +1,82 @@
+#include "arc_flags.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace mapapp {
+arc_flags::arc_flags(const osm_graph &graph, std::size_t depth,
+                     std::size_t num_threads)
+    : graph{graph}, partition{graph, depth, num_threads} {
+  const auto n = graph.nodes.size();
+  const auto regions = num_regions();
+  words = (regions + 63) / 64;
+  arc_first.reserve(n + 1);
+  arc_first.push_back(0);
+  for (const auto &node : graph.nodes) {
+    arc_first.push_back(arc_first.back() + node.adj.size());
+  }
+  flags.assign(arc_first.back() * words, 0);
+
+  // nodes of every region that an arc from another region leads to
+  std::vector<std::vector<index_t>> boundary(regions);
+  for (index_t v = 0; v < n; ++v) {
+    const auto &in = graph.nodes[v].radj;
+    if (std::any_of(in.begin(), in.end(), [&](const auto &arc) {
+          return region(arc.second) != region(v);
+        })) {
+      boundary[region(v)].push_back(v);
+    }
+  }
+
+  // regions share words, so every worker sets the flags of its regions in a
+  // copy of its own that is merged at the end
+  std::atomic<std::size_t> cursor{0};
+  std::mutex merge_mtx;
+  auto work = [&] {
+    std::vector<std::uint64_t> own(flags.size(), 0);
+    shortest_path_tree tree;
+    for (std::size_t r; (r = cursor.fetch_add(1)) < regions;) {
+      const auto word = r / 64;
+      const auto bit = std::uint64_t{1} << (r % 64);
+      // every arc inside the region leads into it
+      for (index_t u = 0; u < n; ++u) {
+        if (region(u) != r) {
+          continue;
+        }
+        for (std::size_t k = 0; k < graph.nodes[u].adj.size(); ++k) {
+          if (region(graph.nodes[u].adj[k].second) == r) {
+            own[(arc_first[u] + k) * words + word] |= bit;
+          }
+        }
+      }
+      // paths from outside enter through a boundary node, a shortest one
+      // along arcs that are tight in its tree
+      for (auto b : boundary[r]) {
+        grow_shortest_path_tree({}, graph, b, {.reverse = true}, tree);
+        for (auto u : tree.settled) {
+          const auto &adj = graph.nodes[u].adj;
+          for (std::size_t k = 0; k < adj.size(); ++k) {
+            auto [weight, v] = adj[k];
+            if (tree.reached(v) &&
+                tree.distance[v] + weight == tree.distance[u]) {
+              own[(arc_first[u] + k) * words + word] |= bit;
+            }
+          }
+        }
+      }
+    }
+    std::scoped_lock lock{merge_mtx};
+    for (std::size_t i = 0; i < flags.size(); ++i) {
+      flags[i] |= own[i];
+    }
+  };
+
+  std::vector<std::jthread> helpers;
+  for (std::size_t id = 1; id < num_threads; ++id) {
+    helpers.emplace_back(work);
+  }
+  work();
+}
+} // namespace mapapp
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "partition.hpp"
+#include "pathfind.hpp"
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace mapapp {
+// arc flags (Lauther; Köhler, Möhring & Schilling). the nodes are split into
+// regions by `graph_partition` and every arc keeps one bit per region, set if
+// the arc is on a shortest path into that region. `arc_flags_search` towards
+// a node only takes arcs flagged for its region: all of them near the target,
+// few more than the ones leading there far from it.
+struct arc_flags {
+  using index_t = osm_graph::index_t;
+
+  const osm_graph &graph;
+  graph_partition partition;
+  // 64-bit words of flags per arc
+  std::size_t words = 0;
+  // arcs node by node in the order of `adj`, those of node u from
+  // arc_first[u], and their flags: region r of arc a is bit r % 64 of
+  // flags[a * words + r / 64]
+  std::vector<std::size_t> arc_first;
+  std::vector<std::uint64_t> flags;
+
+  // 2^depth regions, each computed by one of `num_threads` workers: a
+  // backward search from every node of the region an arc from another region
+  // leads to flags the arcs of its shortest path tree. the calling thread is
+  // one of the workers.
+  explicit arc_flags(const osm_graph &graph, std::size_t depth = 6,
+                     std::size_t num_threads = thread_pool::default_size());
+  arc_flags(const arc_flags &) = delete;
+  auto operator=(const arc_flags &) = delete;
+
+  std::size_t num_regions() const {
+    return partition.num_cells(partition.depth);
+  }
+  std::uint32_t region(index_t node) const {
+    return partition.cell(node, partition.depth);
+  }
+  // the flag of region `r` on the k-th arc of `tail`
+  bool allowed(index_t tail, std::size_t k, std::uint32_t r) const {
+    return flags[(arc_first[tail] + k) * words + r / 64] >> (r % 64) & 1;
+  }
+};
+} // namespace mapapp
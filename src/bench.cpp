@@ -0,0 +1,965 @@
+#include "bench.hpp"
+#include "arc_flags.hpp"
+#include "cch.hpp"
+#include "compressed_graph.hpp"
+#include "contraction.hpp"
+#include "delta_stepping.hpp"
+#include "hub_labels.hpp"
+#include "k_shortest.hpp"
+#include "multilevel_dijkstra.hpp"
+#include "partition.hpp"
+#include "query_engine.hpp"
+#include "routing_profile.hpp"
+#include "transit_node_routing.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fmt/base.h>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace mapapp {
+namespace {
+using clock = std::chrono::high_resolution_clock;
+using index_t = osm_graph::index_t;
+
+// in the order of `algorithms`
+constexpr std::array<std::string_view, algorithms.size()> algorithm_names{
+    "dfs", "bfs", "befs", "ucs", "a_star", "ida_star", "sma_star"};
+
+auto elapsed_ns(clock::time_point since) {
+  return std::chrono::nanoseconds{clock::now() - since}.count();
+}
+
+// the output is CSV, one table after the other: a header line, the rows, and
+// a blank line before the next table. names are quoted.
+void print_header(std::string_view columns) {
+  static bool first = true;
+  if (!first) {
+    fmt::println("");
+  }
+  first = false;
+  fmt::println("{}", columns);
+}
+
+void print_field(const auto &field) {
+  if constexpr (std::is_convertible_v<decltype(field), std::string_view>) {
+    fmt::print("\"{}\"", std::string_view{field});
+  } else {
+    fmt::print("{}", field);
+  }
+}
+
+// one row of the last table
+void print_row(const auto &first, const auto &...rest) {
+  print_field(first);
+  ((fmt::print(","), print_field(rest)), ...);
+  fmt::println("");
+}
+
+index_t random_node(const osm_graph &graph) {
+  static std::mt19937 rng;
+  return std::uniform_int_distribution<index_t>{0, graph.nodes.size() - 1}(
+      rng);
+}
+
+// a node a click could pick
+index_t random_snap_point(const osm_graph &graph) {
+  static std::mt19937 rng;
+  return graph.snap.indices[std::uniform_int_distribution<std::size_t>{
+      0, graph.snap.indices.size() - 1}(rng)];
+}
+
+// calls run(threads) with 1, 2, 4, ... threads up to the number of cores and
+// prints a table with a row for each: `name`, threads, time (ns). `prepare`
+// runs before every call, untimed.
+void sweep_threads(std::string_view name, const auto &run,
+                   const auto &prepare) {
+  print_header("step,threads,time_ns");
+  const auto max_threads = thread_pool::default_size();
+  for (std::size_t threads = 1;; threads = std::min(threads * 2, max_threads)) {
+    prepare();
+    auto time_start = clock::now();
+    run(threads);
+    print_row(name, threads, elapsed_ns(time_start));
+    if (threads == max_threads) {
+      break;
+    }
+  }
+}
+
+void sweep_threads(std::string_view name, const auto &run) {
+  sweep_threads(name, run, [] {});
+}
+
+// a T built from `args` and the thread count for every count of
+// `sweep_threads`, the previous one freed first. returns the last.
+template <class T>
+std::unique_ptr<T> build_with_threads(std::string_view name,
+                                      const auto &...args) {
+  std::unique_ptr<T> built;
+  sweep_threads(
+      name,
+      [&](std::size_t threads) {
+        built = std::make_unique<T>(args..., threads);
+      },
+      [&] { built.reset(); });
+  return built;
+}
+
+// calls fn() and adds the time it took to `total`
+auto timed(std::chrono::nanoseconds &total, const auto &fn) {
+  auto time_start = clock::now();
+  auto result = fn();
+  total += clock::now() - time_start;
+  return result;
+}
+
+// whether `distance` disagrees with the `reference` one. either is NaN or
+// infinity if there is no path.
+bool differs(double distance, double reference) {
+  auto found = std::isfinite(distance), expected = std::isfinite(reference);
+  return found != expected ||
+         (found && std::abs(distance - reference) > 1e-9 * reference);
+}
+
+// UCS and A* on the queries a search is checked on: total time (ns) and
+// settled nodes of each
+struct reference_searches {
+  std::chrono::nanoseconds ucs_time{0}, a_star_time{0};
+  std::size_t ucs_settled = 0, a_star_settled = 0;
+
+  // runs both, returns the result of UCS
+  pathfind_result run(const osm_graph &graph, index_t start, index_t end) {
+    auto reference = timed(ucs_time, [&] {
+      return ucs(std::stop_token{}, graph, start, end, {});
+    });
+    auto guided = timed(a_star_time, [&] {
+      return a_star(std::stop_token{}, graph, start, end, {});
+    });
+    ucs_settled += reference.counters.settled;
+    a_star_settled += guided.counters.settled;
+    return reference;
+  }
+};
+
+// runs N random queries with every algorithm as one batch on 1, 2, 4, ...
+// workers up to the number of cores, each query within `limits`. prints one
+// row per (algorithm, query) of the last batch: algorithm, start, end,
+// distance, execution time (ns), peak and total memory, time spent queued
+// (ns), 1 if the query was stopped early, then the search counters (settled,
+// relaxed, pushes, pops, decrease-keys, max frontier); then one row per batch:
+// threads, queries, wall time (ns), queries per second, worker utilization.
+void run_queries(const osm_graph &graph, std::size_t num_queries,
+                 const search_limits &limits) {
+  std::vector<query_job> jobs;
+  for (std::size_t i = 0; i < num_queries; ++i) {
+    index_t start, end;
+    do {
+      start = random_node(graph);
+      end = random_node(graph);
+    } while (start == end);
+    for (std::size_t k = 0; k < algorithms.size(); ++k) {
+      jobs.push_back({k, start, end});
+    }
+  }
+
+  std::vector<batch_statistics> stats;
+  batch_result batch;
+  const auto max_threads = thread_pool::default_size();
+  for (std::size_t threads = 1;; threads = std::min(threads * 2, max_threads)) {
+    batch = query_engine{graph, threads}.run(jobs, limits);
+    stats.push_back(batch.stats);
+    if (threads == max_threads) {
+      break;
+    }
+  }
+
+  print_header("algorithm,start,end,distance,time_ns,peak_bytes,total_bytes,"
+               "queued_ns,stopped,settled,relaxed,pushes,pops,decrease_keys,"
+               "max_frontier");
+  for (std::size_t i = 0; i < jobs.size(); ++i) {
+    const auto &[k, start, end] = jobs[i];
+    const auto &result = batch.results[i];
+    const auto &c = result.counters;
+    print_row(algorithm_names[k], start, end, result.distance,
+              std::chrono::nanoseconds{result.execution_time()}.count(),
+              result.mem_stat.max_allocated, result.mem_stat.total_allocated,
+              std::chrono::nanoseconds{result.queue_delay()}.count(),
+              result.stopped ? 1 : 0, c.settled, c.relaxed, c.pushes, c.pops,
+              c.decrease_keys, c.max_frontier);
+  }
+  print_header("threads,queries,wall_ns,queries_per_second,utilization");
+  for (const auto &s : stats) {
+    print_row(s.num_threads, s.num_queries, s.wall_time.count(),
+              s.queries_per_second(), s.utilization());
+  }
+}
+
+// compares repeated one-to-all ucs against PHAST with one and several sources
+// per sweep. prints the size and build time (ns) of the hierarchy, then the
+// total time of each method (labels only, checking is not timed) and the
+// largest label difference to ucs.
+void run_phast(const osm_graph &graph, std::size_t num_sources) {
+  std::vector<index_t> sources(num_sources);
+  for (auto &source : sources) {
+    source = random_node(graph);
+  }
+
+  auto time_start = clock::now();
+  contraction_hierarchy ch{graph};
+  print_header("nodes,shortcuts,build_ns");
+  print_row(ch.size(), ch.num_shortcuts, elapsed_ns(time_start));
+
+  std::vector<std::vector<double>> reference;
+  shortest_path_tree tree;
+  time_start = clock::now();
+  for (auto source : sources) {
+    ucs_one_to_all(std::stop_token{}, graph, source,
+                   shortest_path_tree::unreached, tree);
+    reference.push_back(tree.distance);
+  }
+  print_header("method,sources,time_ns,max_error");
+  print_row("ucs", num_sources, elapsed_ns(time_start), 0.0);
+
+  auto bench = [&]<std::size_t lanes>(std::string_view name,
+                                     phast<lanes> &&sweep) {
+    double max_error = 0.0;
+    std::chrono::nanoseconds total{0};
+    for (std::size_t i = 0; i < sources.size(); i += lanes) {
+      auto batch = std::span{sources}.subspan(
+          i, std::min(lanes, sources.size() - i));
+      auto time_start = clock::now();
+      sweep.run(batch);
+      total += clock::now() - time_start;
+      for (std::size_t lane = 0; lane < batch.size(); ++lane) {
+        const auto &expected = reference[i + lane];
+        for (index_t node = 0; node < expected.size(); ++node) {
+          if (expected[node] != sweep(lane, node)) {
+            max_error = std::max(max_error,
+                                 std::abs(expected[node] - sweep(lane, node)));
+          }
+        }
+      }
+    }
+    print_row(name, num_sources, total.count(), max_error);
+  };
+  bench("phast1", phast<1>{ch});
+  bench("phast4", phast<4>{ch});
+  bench("phast8", phast<8>{ch});
+}
+
+// repeated one-to-all ucs against delta-stepping with 1, 2, 4, ... threads up
+// to the number of cores: method, bucket width (0 for ucs), threads, sources,
+// total time (ns) and the number of labels that differ from ucs (checking is
+// not timed)
+void run_delta_stepping(const osm_graph &graph, std::size_t num_sources) {
+  std::vector<index_t> sources(num_sources);
+  for (auto &source : sources) {
+    source = random_node(graph);
+  }
+
+  std::vector<std::vector<double>> reference;
+  shortest_path_tree tree;
+  auto time_start = clock::now();
+  for (auto source : sources) {
+    ucs_one_to_all(std::stop_token{}, graph, source,
+                   shortest_path_tree::unreached, tree);
+    reference.push_back(tree.distance);
+  }
+  print_header("method,delta,threads,sources,time_ns,mismatches");
+  print_row("ucs", 0.0, 1, num_sources, elapsed_ns(time_start), 0);
+
+  delta_stepping sssp{graph};
+  const auto max_threads = thread_pool::default_size();
+  for (std::size_t threads = 1;; threads = std::min(threads * 2, max_threads)) {
+    std::size_t mismatches = 0;
+    std::chrono::nanoseconds total{0};
+    for (std::size_t i = 0; i < sources.size(); ++i) {
+      auto time_start = clock::now();
+      sssp.run(std::stop_token{}, sources[i], threads);
+      total += clock::now() - time_start;
+      for (index_t node = 0; node < reference[i].size(); ++node) {
+        mismatches += reference[i][node] != sssp[node];
+      }
+    }
+    print_row("delta_stepping", sssp.delta, threads, num_sources,
+              total.count(), mismatches);
+    if (threads == max_threads) {
+      break;
+    }
+  }
+}
+
+// N random queries per algorithm, run once with the global heap and once with
+// a reused search arena: algorithm, total time without and with the arena
+// (ns), allocations made by the containers, chunks the arena took from the
+// system
+void run_arena(const osm_graph &graph, std::size_t num_queries) {
+  std::vector<std::pair<index_t, index_t>> queries;
+  for (std::size_t i = 0; i < num_queries; ++i) {
+    index_t start, end;
+    do {
+      start = random_node(graph);
+      end = random_node(graph);
+    } while (start == end);
+    queries.emplace_back(start, end);
+  }
+
+  search_arena arena;
+  print_header("algorithm,heap_ns,arena_ns,allocations,arena_chunks");
+  for (std::size_t k = 0; k < algorithms.size(); ++k) {
+    std::size_t allocations = 0;
+    auto time_start = clock::now();
+    for (auto [start, end] : queries) {
+      auto result = algorithms[k](std::stop_token{}, graph, start, end, {});
+      allocations += result.mem_stat.num_allocations;
+    }
+    auto heap_time = elapsed_ns(time_start);
+
+    auto chunks = arena.num_chunks();
+    time_start = clock::now();
+    for (auto [start, end] : queries) {
+      {
+        search_arena::scope scope{arena};
+        algorithms[k](std::stop_token{}, graph, start, end, {});
+      }
+      arena.reset();
+    }
+    print_row(algorithm_names[k], heap_time, elapsed_ns(time_start),
+              allocations, arena.num_chunks() - chunks);
+  }
+}
+
+// N random queries per algorithm, first each run to completion on its own,
+// then all of them as search tasks taking turns on this thread, every turn
+// expanding K nodes for K = 1, 16, 256, 4096. prints "direct", 0, tasks,
+// total time (ns), 0, then per K: "interleave", K, tasks, total time (ns) and
+// the number of results that differ from the direct run
+void run_interleaved(const osm_graph &graph, std::size_t num_queries) {
+  std::vector<std::pair<index_t, index_t>> queries;
+  for (std::size_t i = 0; i < num_queries; ++i) {
+    index_t start, end;
+    do {
+      start = random_node(graph);
+      end = random_node(graph);
+    } while (start == end);
+    queries.emplace_back(start, end);
+  }
+
+  std::vector<pathfind_result> reference;
+  auto time_start = clock::now();
+  for (auto [start, end] : queries) {
+    for (auto algorithm : algorithms) {
+      reference.push_back(algorithm(std::stop_token{}, graph, start, end, {}));
+    }
+  }
+  print_header("mode,step,tasks,time_ns,mismatches");
+  print_row("direct", 0, reference.size(), elapsed_ns(time_start), 0);
+
+  for (std::size_t step : {1, 16, 256, 4096}) {
+    std::vector<search_task> tasks;
+    time_start = clock::now();
+    for (auto [start, end] : queries) {
+      for (auto stepper : steppers) {
+        tasks.push_back(stepper(std::stop_token{}, graph, start, end, {}));
+        tasks.back().set_step(step);
+      }
+    }
+    for (bool running = true; running;) {
+      running = false;
+      for (auto &task : tasks) {
+        running |= !task.advance();
+      }
+    }
+    auto time = elapsed_ns(time_start);
+
+    std::size_t mismatches = 0;
+    for (std::size_t i = 0; i < tasks.size(); ++i) {
+      const auto &a = tasks[i].result();
+      const auto &b = reference[i];
+      mismatches += a.path != b.path ||
+                    (a.distance != b.distance &&
+                     !(std::isnan(a.distance) && std::isnan(b.distance))) ||
+                    a.counters.settled != b.counters.settled;
+    }
+    print_row("interleave", step, tasks.size(), time, mismatches);
+  }
+}
+
+// the memory-bounded searches on N random queries under memory limits from
+// none down to 16 KiB, each query also stopped after `max_time`. one row per
+// algorithm and limit: name, limit in bytes (0 for none), queries, queries
+// that found the same distance as A*, queries stopped early, total time (ns),
+// highest peak memory, nodes expanded in total. A* itself runs without a limit
+// as the reference.
+void run_memory_bounded(const osm_graph &graph, std::size_t num_queries,
+                        std::chrono::steady_clock::duration max_time) {
+  std::vector<std::pair<index_t, index_t>> queries;
+  std::vector<double> reference;
+  std::size_t reference_settled = 0, reference_memory = 0;
+  auto time_start = clock::now();
+  for (std::size_t i = 0; i < num_queries; ++i) {
+    index_t start, end;
+    do {
+      start = random_node(graph);
+      end = random_node(graph);
+    } while (start == end);
+    queries.emplace_back(start, end);
+    auto result = a_star(std::stop_token{}, graph, start, end, {});
+    reference.push_back(result.distance);
+    reference_settled += result.counters.settled;
+    reference_memory =
+        std::max(reference_memory, result.mem_stat.max_allocated);
+  }
+  print_header("algorithm,max_memory,queries,optimal,stopped,time_ns,"
+               "peak_bytes,settled");
+  print_row("a_star", 0, num_queries, num_queries, 0, elapsed_ns(time_start),
+            reference_memory, reference_settled);
+
+  constexpr std::pair<const char *, pathfind_algo *> bounded[]{
+      {"ida_star", ida_star}, {"sma_star", sma_star}};
+  for (auto [name, algorithm] : bounded) {
+    for (std::size_t max_memory : {0, 1 << 20, 1 << 18, 1 << 16, 1 << 14}) {
+      search_limits limits;
+      limits.max_time = max_time;
+      if (max_memory != 0) {
+        limits.max_memory = max_memory;
+      }
+      std::size_t optimal = 0, stopped = 0, peak = 0, settled = 0;
+      time_start = clock::now();
+      for (std::size_t i = 0; i < queries.size(); ++i) {
+        auto [start, end] = queries[i];
+        auto result = algorithm(std::stop_token{}, graph, start, end, limits);
+        stopped += result.stopped;
+        optimal += !result.stopped &&
+                   (result.distance == reference[i] ||
+                    (std::isnan(result.distance) && std::isnan(reference[i])));
+        peak = std::max(peak, result.mem_stat.max_allocated);
+        settled += result.counters.settled;
+      }
+      print_row(name, max_memory, num_queries, optimal, stopped,
+                elapsed_ns(time_start), peak, settled);
+    }
+  }
+}
+
+// every algorithm on N random pairs of junctions, on the full graph and on
+// the graph with degree-2 runs folded away (unpacking included). prints the
+// sizes of both graphs and the time to build the compressed one (ns), then
+// per algorithm: name, total time on each graph (ns) and the summed distance
+// of the paths found on each, which agree for the exact algorithms
+void run_compressed(const osm_graph &graph, std::size_t num_queries) {
+  auto time_start = clock::now();
+  compressed_graph routing{graph};
+  print_header("nodes,compressed_nodes,build_ns");
+  print_row(graph.nodes.size(), routing.graph.nodes.size(),
+            elapsed_ns(time_start));
+
+  std::vector<std::pair<index_t, index_t>> queries;
+  for (std::size_t i = 0; i < num_queries; ++i) {
+    index_t start, end;
+    do {
+      start = random_node(routing.graph);
+      end = random_node(routing.graph);
+    } while (start == end);
+    queries.emplace_back(start, end);
+  }
+
+  print_header("algorithm,full_ns,compressed_ns,full_distance,"
+               "compressed_distance");
+  for (std::size_t k = 0; k < algorithms.size(); ++k) {
+    std::chrono::nanoseconds full_time{0}, compressed_time{0};
+    double full_distance = 0.0, compressed_distance = 0.0;
+    for (auto [start, end] : queries) {
+      time_start = clock::now();
+      auto full = algorithms[k](std::stop_token{}, graph,
+                                routing.original[start],
+                                routing.original[end], {});
+      full_time += clock::now() - time_start;
+
+      time_start = clock::now();
+      auto compressed =
+          algorithms[k](std::stop_token{}, routing.graph, start, end, {});
+      routing.unpack(compressed);
+      compressed_time += clock::now() - time_start;
+
+      if (full) {
+        full_distance += full.distance;
+      }
+      if (compressed) {
+        compressed_distance += compressed.distance;
+      }
+    }
+    print_row(algorithm_names[k], full_time.count(), compressed_time.count(),
+              full_distance, compressed_distance);
+  }
+}
+
+// customizable CH: nested dissection and contraction, then customization with
+// 1, 2, 4, ... threads up to the number of cores, a new metric with every arc
+// 1-3x slower and one in 20 closed, and N random queries on it against UCS on
+// the same metric. prints the size and build time (ns), one row per thread
+// count with the customization time (ns), then query times (ns) of both and
+// the number of distances that differ
+void run_cch(const osm_graph &graph, std::size_t num_queries) {
+  auto time_start = clock::now();
+  customizable_contraction_hierarchy cch{graph};
+  print_header("nodes,edges,levels,build_ns");
+  print_row(cch.size(), cch.num_edges(), cch.num_levels(),
+            elapsed_ns(time_start));
+
+  std::mt19937 rng;
+  std::uniform_real_distribution<double> slowdown{1.0, 3.0};
+  std::bernoulli_distribution closed{0.05};
+  auto weights = customizable_contraction_hierarchy::weights_of(graph);
+  for (auto &weight : weights) {
+    weight = closed(rng) ? std::numeric_limits<double>::infinity()
+                         : weight * slowdown(rng);
+  }
+  sweep_threads("customize",
+                [&](std::size_t threads) { cch.customize(weights, threads); });
+
+  // the same metric as a graph of its own, for UCS
+  osm_graph::node_vector nodes(graph.nodes.size());
+  auto weight = weights.begin();
+  for (index_t u = 0; u < graph.nodes.size(); ++u) {
+    nodes[u].id = graph.nodes[u].id;
+    nodes[u].location = graph.nodes[u].location;
+    nodes[u].position = graph.nodes[u].position;
+    for (const auto &[_, v] : graph.nodes[u].adj) {
+      if (auto w = *weight++; w != std::numeric_limits<double>::infinity()) {
+        nodes[u].adj.emplace_back(w, v);
+        nodes[v].radj.emplace_back(w, u);
+      }
+    }
+  }
+  osm_graph reweighted{std::move(nodes)};
+
+  std::chrono::nanoseconds ucs_time{0}, cch_time{0};
+  std::size_t mismatches = 0;
+  for (std::size_t i = 0; i < num_queries; ++i) {
+    auto start = random_snap_point(graph);
+    auto end = random_snap_point(graph);
+    auto reference = timed(ucs_time, [&] {
+      return ucs(std::stop_token{}, reweighted, start, end, {});
+    });
+    auto result = timed(
+        cch_time, [&] { return cch.query(std::stop_token{}, start, end); });
+    mismatches += differs(result.distance, reference.distance);
+  }
+  print_header("queries,ucs_ns,cch_ns,mismatches");
+  print_row(num_queries, ucs_time.count(), cch_time.count(), mismatches);
+}
+
+// multi-level Dijkstra: partition and overlay, customization with 1, 2, 4,
+// ... threads up to the number of cores, then N random queries against UCS
+// and A*. prints the build time (ns) and per level the bisection depth,
+// boundary nodes and clique entries, one row per thread count with the
+// customization time (ns), then the total time (ns) and settled nodes of UCS,
+// A* and the overlay, and the number of distances that differ from UCS
+void run_crp(const osm_graph &graph, std::size_t num_queries) {
+  auto time_start = clock::now();
+  multilevel_overlay overlay{graph};
+  print_header("build_ns");
+  print_row(elapsed_ns(time_start));
+  print_header("depth,boundary_nodes,clique_entries");
+  for (const auto &level : overlay.levels) {
+    print_row(level.depth, level.boundary.size(), level.clique.size());
+  }
+
+  auto weights = multilevel_overlay::weights_of(graph);
+  sweep_threads("customize", [&](std::size_t threads) {
+    overlay.customize(weights, threads);
+  });
+
+  reference_searches references;
+  std::chrono::nanoseconds crp_time{0};
+  std::size_t crp_settled = 0, mismatches = 0;
+  for (std::size_t i = 0; i < num_queries; ++i) {
+    auto start = random_snap_point(graph);
+    auto end = random_snap_point(graph);
+    auto reference = references.run(graph, start, end);
+    auto result = timed(
+        crp_time, [&] { return overlay.query(std::stop_token{}, start, end); });
+    crp_settled += result.counters.settled;
+    mismatches += differs(result.distance, reference.distance);
+  }
+  print_header("queries,ucs_ns,a_star_ns,crp_ns,ucs_settled,a_star_settled,"
+               "crp_settled,mismatches");
+  print_row(num_queries, references.ucs_time.count(),
+            references.a_star_time.count(), crp_time.count(),
+            references.ucs_settled, references.a_star_settled, crp_settled,
+            mismatches);
+}
+
+// arc flags for 64 regions, computed with 1, 2, 4, ... threads up to the
+// number of cores, then N random queries against UCS and A*. prints one line
+// per thread count with the time (ns), then the regions, the share of flags
+// set and the size of the flags (bytes), then the total time (ns) and settled
+// nodes of UCS, A* and the arc-flag search, and the number of distances that
+// differ from UCS
+void run_arc_flags(const osm_graph &graph, std::size_t num_queries) {
+  auto flags =
+      build_with_threads<arc_flags>("arc_flags", graph, std::size_t{6});
+  std::size_t set = 0;
+  for (auto word : flags->flags) {
+    set += std::popcount(word);
+  }
+  auto num_arcs = flags->arc_first.back();
+  print_header("regions,flags_set,bytes");
+  print_row(flags->num_regions(),
+            num_arcs == 0 ? 0.0
+                          : static_cast<double>(set) / num_arcs /
+                                flags->num_regions(),
+            flags->flags.size() * sizeof(std::uint64_t));
+
+  reference_searches references;
+  std::chrono::nanoseconds flags_time{0};
+  std::size_t flags_settled = 0, mismatches = 0;
+  for (std::size_t i = 0; i < num_queries; ++i) {
+    auto start = random_snap_point(graph);
+    auto end = random_snap_point(graph);
+    auto reference = references.run(graph, start, end);
+    auto result = timed(flags_time, [&] {
+      return arc_flags_search(std::stop_token{}, *flags, start, end);
+    });
+    flags_settled += result.counters.settled;
+    mismatches += differs(result.distance, reference.distance);
+  }
+  print_header("queries,ucs_ns,a_star_ns,arc_flags_ns,ucs_settled,"
+               "a_star_settled,arc_flags_settled,mismatches");
+  print_row(num_queries, references.ucs_time.count(),
+            references.a_star_time.count(), flags_time.count(),
+            references.ucs_settled, references.a_star_settled, flags_settled,
+            mismatches);
+}
+
+// hub labels from a contraction hierarchy, built with 1, 2, 4, ... threads up
+// to the number of cores, saved to a temporary file and mapped back in as on
+// startup, then N random queries on the mapped labels against the CH query.
+// prints the CH build time (ns), one row per thread count with the time
+// (ns), then the entries per label, the size of the labels (bytes) and the
+// save and map time (ns); then one row per size class, the summed size of
+// the two labels a query merges from 2^k up to 2^(k+1) entries: 2^k,
+// queries, total hub label and CH time (ns); then the total time of both (ns)
+// and the number of distances that differ
+void run_hub_labels(const osm_graph &graph, std::size_t num_queries) {
+  auto time_start = clock::now();
+  contraction_hierarchy ch{graph};
+  print_header("nodes,build_ns");
+  print_row(ch.size(), elapsed_ns(time_start));
+
+  auto built = build_with_threads<hub_labels>("hub_labels", ch);
+
+  auto path = std::filesystem::temp_directory_path() / "mapapp.hub-labels";
+  time_start = clock::now();
+  built->save(path, graph);
+  auto save_time = elapsed_ns(time_start);
+  // the mapped labels replace the built ones
+  time_start = clock::now();
+  built = std::make_unique<hub_labels>(path, graph);
+  auto map_time = elapsed_ns(time_start);
+  const auto &labels = *built;
+  print_header("entries_per_label,bytes,save_ns,map_ns");
+  print_row(labels.size() == 0 ? 0.0
+                               : static_cast<double>(labels.num_entries()) /
+                                     (2 * labels.size()),
+            labels.bytes(), save_time, map_time);
+
+  struct size_class {
+    std::size_t queries = 0;
+    std::chrono::nanoseconds labels_time{0}, ch_time{0};
+  };
+  std::vector<size_class> classes;
+  std::chrono::nanoseconds labels_time{0}, ch_time{0};
+  std::size_t mismatches = 0;
+  for (std::size_t i = 0; i < num_queries; ++i) {
+    auto start = random_snap_point(graph);
+    auto end = random_snap_point(graph);
+    std::chrono::nanoseconds ch_query_time{0}, labels_query_time{0};
+    auto reference = timed(ch_query_time, [&] {
+      return ch.query(std::stop_token{}, start, end);
+    });
+    auto distance = timed(labels_query_time,
+                          [&] { return labels.distance(start, end); });
+    ch_time += ch_query_time;
+    labels_time += labels_query_time;
+    mismatches += differs(distance, reference.distance);
+
+    auto merged = labels.forward(start).hubs.size() +
+                  labels.backward(end).hubs.size();
+    auto k = std::bit_width(merged);
+    if (classes.size() < k + 1) {
+      classes.resize(k + 1);
+    }
+    ++classes[k].queries;
+    classes[k].labels_time += labels_query_time;
+    classes[k].ch_time += ch_query_time;
+  }
+  print_header("entries,queries,hub_labels_ns,ch_ns");
+  for (std::size_t k = 1; k < classes.size(); ++k) {
+    if (classes[k].queries > 0) {
+      print_row(std::size_t{1} << (k - 1), classes[k].queries,
+                classes[k].labels_time.count(), classes[k].ch_time.count());
+    }
+  }
+  print_header("queries,hub_labels_ns,ch_ns,mismatches");
+  print_row(num_queries, labels_time.count(), ch_time.count(), mismatches);
+  // a file cannot be removed while it is mapped on windows
+  built.reset();
+  std::filesystem::remove(path);
+}
+
+// transit node routing on the 1024 highest ranks of a contraction hierarchy,
+// built with 1, 2, 4, ... threads up to the number of cores, then N random
+// queries against the CH query. prints the CH build time (ns), one row per
+// thread count with the time (ns), then the transit nodes, access nodes per
+// node forward and backward, the size of the table and of everything (bytes);
+// then one row per distance class, paths from 2^k up to 2^(k+1) long: 2^k
+// (0 for the shortest), queries, local ones, the median, 90th and 99th
+// percentile and the largest query time (ns) with transit nodes and the same
+// with CH; then the total time of both (ns), local queries and the number of
+// distances that differ
+void run_transit_nodes(const osm_graph &graph, std::size_t num_queries) {
+  auto time_start = clock::now();
+  contraction_hierarchy ch{graph};
+  print_header("nodes,build_ns");
+  print_row(ch.size(), elapsed_ns(time_start));
+
+  auto tnr = build_with_threads<transit_node_routing>("transit_nodes", graph,
+                                                      ch, std::size_t{1024});
+  auto per_node = [&](std::size_t s) {
+    return graph.nodes.empty() ? 0.0
+                               : static_cast<double>(tnr->access[s].size()) /
+                                     graph.nodes.size();
+  };
+  print_header("transit_nodes,forward_access,backward_access,table_bytes,"
+               "bytes");
+  print_row(tnr->num_transit, per_node(0), per_node(1),
+            tnr->table.size() * sizeof(double), tnr->bytes());
+
+  struct distance_class {
+    std::size_t local = 0;
+    std::vector<std::chrono::nanoseconds> tnr_times, ch_times;
+  };
+  std::vector<distance_class> classes;
+  std::chrono::nanoseconds tnr_time{0}, ch_time{0};
+  std::size_t local = 0, mismatches = 0;
+  for (std::size_t i = 0; i < num_queries; ++i) {
+    auto start = random_snap_point(graph);
+    auto end = random_snap_point(graph);
+    std::chrono::nanoseconds ch_query_time{0}, tnr_query_time{0};
+    auto reference = timed(ch_query_time, [&] {
+      return ch.query(std::stop_token{}, start, end);
+    });
+    auto distance =
+        timed(tnr_query_time, [&] { return tnr->distance(start, end); });
+    ch_time += ch_query_time;
+    tnr_time += tnr_query_time;
+    local += tnr->local(start, end);
+    mismatches += differs(distance, reference.distance);
+    if (!reference) {
+      continue;
+    }
+
+    std::size_t k =
+        std::bit_width(static_cast<std::uint64_t>(reference.distance));
+    if (classes.size() < k + 1) {
+      classes.resize(k + 1);
+    }
+    classes[k].local += tnr->local(start, end);
+    classes[k].tnr_times.push_back(tnr_query_time);
+    classes[k].ch_times.push_back(ch_query_time);
+  }
+  // median, 90th and 99th percentile, largest
+  auto percentiles = [](std::vector<std::chrono::nanoseconds> &times) {
+    std::sort(times.begin(), times.end());
+    auto at = [&](double q) {
+      return times[std::min(times.size() - 1,
+                            static_cast<std::size_t>(q * times.size()))]
+          .count();
+    };
+    return std::array{at(0.5), at(0.9), at(0.99), times.back().count()};
+  };
+  print_header("distance,queries,local,transit_nodes_p50_ns,"
+               "transit_nodes_p90_ns,transit_nodes_p99_ns,transit_nodes_max_ns,"
+               "ch_p50_ns,ch_p90_ns,ch_p99_ns,ch_max_ns");
+  for (std::size_t k = 0; k < classes.size(); ++k) {
+    auto &c = classes[k];
+    if (!c.tnr_times.empty()) {
+      auto tnr_p = percentiles(c.tnr_times), ch_p = percentiles(c.ch_times);
+      print_row(k == 0 ? 0 : std::uint64_t{1} << (k - 1), c.tnr_times.size(),
+                c.local, tnr_p[0], tnr_p[1], tnr_p[2], tnr_p[3], ch_p[0],
+                ch_p[1], ch_p[2], ch_p[3]);
+    }
+  }
+  print_header("queries,transit_nodes_ns,ch_ns,local,mismatches");
+  print_row(num_queries, tnr_time.count(), ch_time.count(), local,
+            mismatches);
+}
+
+// recursive bisection into N levels (at most 32) with 1, 2, 4, ... threads
+// up to the number of cores, then the last partition saved and loaded again.
+// prints one row per thread count with the time (ns), one row per level:
+// level, cells, arcs between cells, smallest and largest cell; then the size
+// of the saved partition (bytes), save and load time (ns) and 1 if the loaded
+// one is the same
+void run_partition(const osm_graph &graph, std::size_t depth) {
+  depth = std::min(depth, graph_partition::max_depth);
+  graph_partition partition;
+  sweep_threads("partition", [&](std::size_t threads) {
+    partition = graph_partition{graph, depth, threads};
+  });
+  auto levels = partition.statistics(graph);
+  print_header("level,cells,cut_arcs,min_cell,max_cell");
+  for (std::size_t l = 0; l < levels.size(); ++l) {
+    print_row(l + 1, levels[l].cells, levels[l].cut_arcs, levels[l].min_cell,
+              levels[l].max_cell);
+  }
+
+  std::stringstream file;
+  auto time_start = clock::now();
+  partition.save(file, graph);
+  auto save_time = elapsed_ns(time_start);
+  time_start = clock::now();
+  auto loaded = graph_partition::load(file, graph);
+  auto load_time = elapsed_ns(time_start);
+  print_header("bytes,save_ns,load_ns,same");
+  print_row(file.str().size(), save_time, load_time,
+            loaded.depth == partition.depth && loaded.code == partition.code
+                ? 1
+                : 0);
+}
+
+// the graph by length and by each routing profile, with UCS and A* on N random
+// queries each. prints per graph: profile ("length" for lengths, then the
+// name of each of `profiles`), nodes, arcs, build time (ns), total UCS and A*
+// time (ns), nodes
+// settled by each, and the queries where A* found a longer path than UCS,
+// which an overestimating heuristic would cause
+void run_profiles(const map_loader &map, std::size_t num_queries) {
+  print_header("profile,nodes,arcs,build_ns,ucs_ns,a_star_ns,ucs_settled,"
+               "a_star_settled,worse");
+  for (std::size_t k = 0; k <= profiles.size(); ++k) {
+    auto time_start = clock::now();
+    osm_graph graph{map, k == 0 ? nullptr : &profiles[k - 1]};
+    auto build_time = elapsed_ns(time_start);
+    std::size_t arcs = 0;
+    for (const auto &node : graph.nodes) {
+      arcs += node.adj.size();
+    }
+
+    std::chrono::nanoseconds ucs_time{0}, a_star_time{0};
+    std::size_t ucs_settled = 0, a_star_settled = 0, worse = 0;
+    for (std::size_t i = 0; i < num_queries; ++i) {
+      auto start = random_snap_point(graph);
+      auto end = random_snap_point(graph);
+      time_start = clock::now();
+      auto reference = ucs(std::stop_token{}, graph, start, end, {});
+      ucs_time += clock::now() - time_start;
+      time_start = clock::now();
+      auto result = a_star(std::stop_token{}, graph, start, end, {});
+      a_star_time += clock::now() - time_start;
+      ucs_settled += reference.counters.settled;
+      a_star_settled += result.counters.settled;
+      worse += result.distance > reference.distance * (1.0 + 1e-9);
+    }
+    print_row(k == 0 ? "length" : profiles[k - 1].name, graph.nodes.size(),
+              arcs, build_time, ucs_time.count(), a_star_time.count(),
+              ucs_settled, a_star_settled, worse);
+  }
+}
+
+// k = 5 and k = 20 shortest loopless paths for N random queries: k, start,
+// end, number of paths found, distance of the last one, time (ns)
+void run_k_shortest(const osm_graph &graph, std::size_t num_queries) {
+  k_shortest_workspace workspace;
+  print_header("k,start,end,paths,distance,time_ns");
+  for (std::size_t i = 0; i < num_queries; ++i) {
+    index_t start, end;
+    do {
+      start = random_node(graph);
+      end = random_node(graph);
+    } while (start == end);
+
+    for (std::size_t k : {5, 20}) {
+      auto time_start = clock::now();
+      auto paths = k_shortest_paths(std::stop_token{}, graph, start, end, k,
+                                    workspace)
+                       .paths;
+      auto time = elapsed_ns(time_start);
+      print_row(k, start, end, paths.size(),
+                paths.empty() ? NAN : paths.back().distance, time);
+    }
+  }
+}
+} // namespace
+
+int run_batch(const map_loader &map, const osm_graph &graph,
+              std::span<char *> args) {
+  std::string_view mode = args.empty() ? "" : args[0];
+  // only --queries and --memory take a third argument, the time limit per
+  // query in ms
+  if (args.size() != 2 &&
+      !(args.size() == 3 && (mode == "--queries" || mode == "--memory"))) {
+    fmt::println("Tham số không hợp lệ");
+    return 1;
+  }
+
+  auto count = std::stoul(args[1]);
+  if (mode == "--queries") {
+    search_limits limits;
+    if (args.size() == 3) {
+      limits.max_time = std::chrono::milliseconds{std::stoul(args[2])};
+    }
+    run_queries(graph, count, limits);
+  } else if (mode == "--phast") {
+    run_phast(graph, count);
+  } else if (mode == "--sssp") {
+    run_delta_stepping(graph, count);
+  } else if (mode == "--arena") {
+    run_arena(graph, count);
+  } else if (mode == "--interleave") {
+    run_interleaved(graph, count);
+  } else if (mode == "--memory") {
+    // memory-bounded searches can take very long on small limits
+    std::chrono::steady_clock::duration max_time = std::chrono::seconds{10};
+    if (args.size() == 3) {
+      max_time = std::chrono::milliseconds{std::stoul(args[2])};
+    }
+    run_memory_bounded(graph, count, max_time);
+  } else if (mode == "--compressed") {
+    run_compressed(graph, count);
+  } else if (mode == "--cch") {
+    run_cch(graph, count);
+  } else if (mode == "--crp") {
+    run_crp(graph, count);
+  } else if (mode == "--arc-flags") {
+    run_arc_flags(graph, count);
+  } else if (mode == "--hub-labels") {
+    run_hub_labels(graph, count);
+  } else if (mode == "--transit-nodes") {
+    run_transit_nodes(graph, count);
+  } else if (mode == "--partition") {
+    run_partition(graph, count);
+  } else if (mode == "--profiles") {
+    run_profiles(map, count);
+  } else if (mode == "--ksp") {
+    run_k_shortest(graph, count);
+  } else {
+    fmt::println("Chế độ không hợp lệ: {}", mode);
+    return 1;
+  }
+  return 0;
+}
+} // namespace mapapp
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "pathfind.hpp"
+#include <span>
+
+namespace mapapp {
+// command line batch modes, run instead of the UI when arguments follow the
+// map path. returns the process exit code.
+int run_batch(const map_loader &map, const osm_graph &graph,
+              std::span<char *> args);
+} // namespace mapapp
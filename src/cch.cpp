@@ -0,0 +1,369 @@
+#include "cch.hpp"
+#include "partition.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <barrier>
+#include <cassert>
+#include <limits>
+#include <numeric>
+#include <thread>
+
+namespace mapapp {
+namespace {
+using index_t = osm_graph::index_t;
+using cch = customizable_contraction_hierarchy;
+constexpr auto infinity = std::numeric_limits<double>::infinity();
+constexpr auto no_node = cch::no_node;
+
+// node of every rank. inertial flow cuts each cell in two and the ends of the
+// cut edges on the side with fewer of them separate the halves; the separator
+// takes the highest ranks of the cell and both halves are ordered the same
+// way below it.
+std::vector<index_t>
+nested_dissection(const osm_graph &graph,
+                  const std::vector<std::vector<index_t>> &neighbours) {
+  // cells this small are ordered as they are
+  constexpr std::size_t min_cell = 4;
+
+  const auto n = graph.nodes.size();
+  std::vector<index_t> order(n);
+  std::vector<bool> separated(n);
+  inertial_flow bisect{graph, neighbours};
+
+  struct cell {
+    std::vector<index_t> nodes;
+    // lowest rank of the cell
+    std::size_t first;
+  };
+  std::vector<cell> cells;
+  cells.push_back({std::vector<index_t>(n), 0});
+  std::iota(cells.back().nodes.begin(), cells.back().nodes.end(), index_t{0});
+
+  while (!cells.empty()) {
+    auto [nodes, first] = std::move(cells.back());
+    cells.pop_back();
+    if (nodes.size() <= min_cell) {
+      std::copy(nodes.begin(), nodes.end(), order.begin() + first);
+      continue;
+    }
+
+    auto [halves, cut] = bisect(nodes);
+    std::array<std::vector<index_t>, 2> ends;
+    for (auto [a, b] : cut) {
+      ends[0].push_back(a);
+      ends[1].push_back(b);
+    }
+    for (auto &side : ends) {
+      std::sort(side.begin(), side.end());
+      side.erase(std::unique(side.begin(), side.end()), side.end());
+    }
+    int h = ends[0].size() <= ends[1].size() ? 0 : 1;
+    const auto &separator = ends[h];
+    for (auto v : separator) {
+      separated[v] = true;
+    }
+    std::erase_if(halves[h], [&](index_t v) { return separated[v]; });
+
+    auto top = first + nodes.size() - separator.size();
+    std::copy(separator.begin(), separator.end(), order.begin() + top);
+    cells.push_back({std::move(halves[0]), first});
+    cells.push_back({std::move(halves[1]), first + cells.back().nodes.size()});
+  }
+  return order;
+}
+} // namespace
+
+cch::customizable_contraction_hierarchy(const osm_graph &graph)
+    : graph{graph} {
+  const auto n = graph.nodes.size();
+  auto neighbours = undirected_neighbours(graph);
+  node = nested_dissection(graph, neighbours);
+  rank.resize(n);
+  for (index_t r = 0; r < n; ++r) {
+    rank[node[r]] = r;
+  }
+
+  // eliminating the ranks in order joins the higher neighbours of each into
+  // a clique. the lowest of them inherits the others, which is enough: the
+  // rest of the clique is added when it is eliminated in turn.
+  std::vector<std::vector<index_t>> upper(n);
+  for (index_t u = 0; u < n; ++u) {
+    for (auto v : neighbours[u]) {
+      if (rank[u] < rank[v]) {
+        upper[rank[u]].push_back(rank[v]);
+      }
+    }
+  }
+  neighbours = {};
+  parent.assign(n, no_node);
+  up_first.reserve(n + 1);
+  for (index_t r = 0; r < n; ++r) {
+    auto &heads = upper[r];
+    std::sort(heads.begin(), heads.end());
+    heads.erase(std::unique(heads.begin(), heads.end()), heads.end());
+    up_first.push_back(up_head.size());
+    up_head.insert(up_head.end(), heads.begin(), heads.end());
+    if (!heads.empty()) {
+      parent[r] = heads.front();
+      auto &inherited = upper[heads.front()];
+      inherited.insert(inherited.end(), heads.begin() + 1, heads.end());
+    }
+    heads = {};
+  }
+  up_first.push_back(up_head.size());
+
+  down_first.assign(n + 1, 0);
+  for (auto h : up_head) {
+    ++down_first[h + 1];
+  }
+  for (index_t r = 0; r < n; ++r) {
+    down_first[r + 1] += down_first[r];
+  }
+  down_edges.resize(up_head.size());
+  auto fill = down_first;
+  for (index_t r = 0; r < n; ++r) {
+    for (auto e = up_first[r]; e < up_first[r + 1]; ++e) {
+      down_edges[fill[up_head[e]]++] = {r, e};
+    }
+  }
+
+  std::vector<std::size_t> level(n, 0);
+  std::size_t num_levels = n == 0 ? 0 : 1;
+  for (index_t r = 0; r < n; ++r) {
+    for (auto k = down_first[r]; k < down_first[r + 1]; ++k) {
+      level[r] = std::max(level[r], level[down_edges[k].first] + 1);
+    }
+    num_levels = std::max(num_levels, level[r] + 1);
+  }
+  // a task walks all lower neighbours of its rank, so ranks are only split
+  // in levels too small to keep the workers busy, into tasks of about this
+  // many steps: one per edge and lower neighbour
+  constexpr std::size_t min_level = 256, task_size = 1 << 15;
+  std::vector<std::vector<task>> levels(num_levels);
+  std::vector<std::size_t> level_size(num_levels);
+  for (index_t r = 0; r < n; ++r) {
+    ++level_size[level[r]];
+  }
+  for (index_t r = 0; r < n; ++r) {
+    auto step = up_first[r + 1] - up_first[r];
+    if (level_size[level[r]] < min_level) {
+      step = std::max<std::size_t>(
+          1, task_size / std::max<std::size_t>(1, down_first[r + 1] -
+                                                      down_first[r]));
+    }
+    for (auto e = up_first[r]; e < up_first[r + 1]; e += step) {
+      levels[level[r]].push_back({r, e, std::min(e + step, up_first[r + 1])});
+    }
+  }
+  level_first.reserve(num_levels + 1);
+  for (auto &level_tasks : levels) {
+    level_first.push_back(tasks.size());
+    tasks.insert(tasks.end(), level_tasks.begin(), level_tasks.end());
+    level_tasks = {};
+  }
+  level_first.push_back(tasks.size());
+
+  for (index_t u = 0; u < n; ++u) {
+    for (const auto &[weight, v] : graph.nodes[u].adj) {
+      arc_edge.push_back(u == v ? no_edge
+                                : find_edge(rank[u], rank[v]) * 2 +
+                                      (rank[u] > rank[v]));
+    }
+  }
+  customize(weights_of(graph));
+}
+
+std::vector<double> cch::weights_of(const osm_graph &graph) {
+  std::vector<double> weights;
+  for (const auto &vertex : graph.nodes) {
+    for (const auto &[weight, head] : vertex.adj) {
+      weights.push_back(weight);
+    }
+  }
+  return weights;
+}
+
+std::size_t cch::find_edge(index_t a, index_t b) const {
+  auto [low, high] = std::minmax(a, b);
+  auto first = up_head.begin() + up_first[low];
+  auto last = up_head.begin() + up_first[low + 1];
+  auto it = std::lower_bound(first, last, high);
+  return it != last && *it == high ? it - up_head.begin() : no_edge;
+}
+
+void cch::customize(std::span<const double> weights,
+                    std::size_t num_threads) {
+  // tasks claimed at once from a level
+  constexpr std::size_t chunk = 16;
+  assert(weights.size() == arc_edge.size());
+
+  up_weight.assign(num_edges(), infinity);
+  down_weight.assign(num_edges(), infinity);
+  up_middle.assign(num_edges(), no_node);
+  down_middle.assign(num_edges(), no_node);
+  for (std::size_t i = 0; i < weights.size(); ++i) {
+    if (auto e = arc_edge[i]; e != no_edge) {
+      auto &weight = (e % 2 ? down_weight : up_weight)[e / 2];
+      weight = std::min(weight, weights[i]);
+    }
+  }
+
+  // every lower triangle {r, x, y} of the edges {x, y} at `x` may shorten
+  // them. the edges {r, x} and {r, y} are at `r`, which is in an earlier level
+  // and final, and each edge is in one task, so a level needs no locks.
+  auto relax = [&](const task &t) {
+    auto x = t.rank;
+    auto last_head = up_head[t.last - 1];
+    for (auto k = down_first[x]; k < down_first[x + 1]; ++k) {
+      auto [r, rx] = down_edges[k];
+      // every higher neighbour of `r` above `x` is one of `x` as well
+      auto e = t.first;
+      std::size_t ry = rx + 1;
+      if (t.first != up_first[x]) {
+        ry = std::lower_bound(up_head.begin() + ry,
+                              up_head.begin() + up_first[r + 1],
+                              up_head[t.first]) -
+             up_head.begin();
+      }
+      for (; ry < up_first[r + 1] && up_head[ry] <= last_head; ++ry) {
+        while (up_head[e] != up_head[ry]) {
+          ++e;
+        }
+        if (auto w = down_weight[rx] + up_weight[ry]; w < up_weight[e]) {
+          up_weight[e] = w;
+          up_middle[e] = r;
+        }
+        if (auto w = down_weight[ry] + up_weight[rx]; w < down_weight[e]) {
+          down_weight[e] = w;
+          down_middle[e] = r;
+        }
+      }
+    }
+  };
+
+  num_threads = std::max<std::size_t>(num_threads, 1);
+  std::size_t level = 0;
+  std::atomic<std::size_t> cursor{0};
+  auto next_level = [&]() noexcept {
+    ++level;
+    cursor = 0;
+  };
+  std::barrier level_sync{static_cast<std::ptrdiff_t>(num_threads),
+                          next_level};
+
+  auto work = [&] {
+    while (level < num_levels()) {
+      auto first = level_first[level];
+      auto size = level_first[level + 1] - first;
+      for (std::size_t i; (i = cursor.fetch_add(chunk)) < size;) {
+        for (auto end = std::min(i + chunk, size); i < end; ++i) {
+          relax(tasks[first + i]);
+        }
+      }
+      level_sync.arrive_and_wait();
+    }
+  };
+
+  std::vector<std::jthread> helpers;
+  for (std::size_t id = 1; id < num_threads; ++id) {
+    helpers.emplace_back(work);
+  }
+  work();
+}
+
+void cch::unpack(index_t tail, index_t head, std::vector<index_t> &out) const {
+  auto e = find_edge(tail, head);
+  auto middle = tail < head ? up_middle[e] : down_middle[e];
+  if (middle == no_node) {
+    out.push_back(head);
+    return;
+  }
+  unpack(tail, middle, out);
+  unpack(middle, head, out);
+}
+
+pathfind_result cch::query(std::stop_token token, index_t start, index_t end,
+                           const search_limits &limits) const {
+  pathfind_result result;
+  search_control control{token, limits, &result.mem_stat};
+  if (!graph.may_reach(start, end)) {
+    return result;
+  }
+
+  // rank -> (distance, parent rank)
+  using labels_t = pf_map<index_t, std::pair<double, index_t>>;
+  std::array<labels_t, 2> labels{labels_t{&result.mem_stat},
+                                 labels_t{&result.mem_stat}};
+
+  const std::array<index_t, 2> sources{rank[start], rank[end]};
+  for (int side = 0; side < 2; ++side) {
+    // towards `end` the arcs are walked backwards, down from their heads
+    const auto &weight = side == 0 ? up_weight : down_weight;
+    labels[side][sources[side]] = {0.0, no_node};
+    for (auto r = sources[side]; r != no_node; r = parent[r]) {
+      if (control.expand()) {
+        result.stopped = control.stopped();
+        return result;
+      }
+      auto it = labels[side].find(r);
+      if (it == labels[side].end()) {
+        continue;
+      }
+      result.counters.settle();
+      control.settle(node[r]);
+      auto dist = it->second.first;
+      for (auto e = up_first[r]; e < up_first[r + 1]; ++e) {
+        if (weight[e] == infinity) {
+          continue;
+        }
+        auto next_dist = dist + weight[e];
+        auto [next, inserted] =
+            labels[side].try_emplace(up_head[e], next_dist, r);
+        if (!inserted && next_dist < next->second.first) {
+          next->second = {next_dist, r};
+        }
+      }
+    }
+  }
+
+  auto best = infinity;
+  auto meet = no_node;
+  for (const auto &[r, label] : labels[0]) {
+    if (auto it = labels[1].find(r); it != labels[1].end()) {
+      if (label.first + it->second.first < best) {
+        best = label.first + it->second.first;
+        meet = r;
+      }
+    }
+  }
+  if (meet == no_node) {
+    return result;
+  }
+
+  std::vector<index_t> forward{meet};
+  while (forward.back() != sources[0]) {
+    forward.push_back(labels[0].at(forward.back()).second);
+  }
+  std::reverse(forward.begin(), forward.end());
+
+  std::vector<index_t> ranks{forward.front()};
+  for (std::size_t i = 0; i + 1 < forward.size(); ++i) {
+    unpack(forward[i], forward[i + 1], ranks);
+  }
+  for (auto cur = meet; cur != sources[1];) {
+    auto next = labels[1].at(cur).second;
+    unpack(cur, next, ranks);
+    cur = next;
+  }
+
+  // unpacked from `start`, returned from `end`
+  result.path.reserve(ranks.size());
+  for (auto it = ranks.rbegin(); it != ranks.rend(); ++it) {
+    result.path.push_back(node[*it]);
+  }
+  result.distance = best;
+  return result;
+}
+} // namespace mapapp
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "pathfind.hpp"
+#include "thread_pool.hpp"
+#include <span>
+#include <stop_token>
+#include <vector>
+
+namespace mapapp {
+// customizable contraction hierarchy (Dibbelt, Strasser & Wagner). the order
+// comes from nested dissection of the roads alone and every pair of higher
+// neighbours of a node is joined by an edge, so the hierarchy does not depend
+// on the weights. `customize` fills in the weights of all edges afterwards,
+// in parallel and much faster than building a `contraction_hierarchy`, so a
+// closure or new traffic only costs a customization.
+struct customizable_contraction_hierarchy {
+  using index_t = osm_graph::index_t;
+  static constexpr auto no_node = static_cast<index_t>(-1);
+  static constexpr auto no_edge = static_cast<std::size_t>(-1);
+
+  const osm_graph &graph;
+  // rank of every node index, and the node index of every rank
+  std::vector<index_t> rank, node;
+  // undirected edges, stored at the lower ranked endpoint with the higher
+  // ranks in ascending order
+  std::vector<std::size_t> up_first;
+  std::vector<index_t> up_head;
+  // every edge again at its higher endpoint, as (lower rank, edge)
+  std::vector<std::size_t> down_first;
+  std::vector<std::pair<index_t, std::size_t>> down_edges;
+  // lowest higher neighbour of every rank, the root of each tree has none.
+  // the upward search space of a node is its path to the root.
+  std::vector<index_t> parent;
+  // the work of `customize`, as ranges [first, last) of the edges at a rank,
+  // grouped by level: every lower neighbour of a rank is in an earlier level.
+  // the cliques of the top separators are few but large, so their edges are
+  // split into several tasks that can run at the same time.
+  struct task {
+    index_t rank;
+    std::size_t first, last;
+  };
+  std::vector<std::size_t> level_first;
+  std::vector<task> tasks;
+  // edge of every arc of the graph in `customize` order, times 2, plus 1 if
+  // it leads down. `no_edge` for loops.
+  std::vector<std::size_t> arc_edge;
+
+  // the metric, per edge {r, h} with r < h: weights of r -> h and h -> r,
+  // infinity if there is no such path, and the rank of the lower node the
+  // shortest one goes through, `no_node` for an arc of the graph
+  std::vector<double> up_weight, down_weight;
+  std::vector<index_t> up_middle, down_middle;
+
+  explicit customizable_contraction_hierarchy(const osm_graph &graph);
+
+  std::size_t size() const { return node.size(); }
+  std::size_t num_edges() const { return up_head.size(); }
+  std::size_t num_levels() const { return level_first.size() - 1; }
+
+  // the arc weights of `graph` in the order `customize` takes: node by node,
+  // each node's arcs in the order of `adj`
+  static std::vector<double> weights_of(const osm_graph &graph);
+
+  // replaces the metric. `weights` has one entry per arc of the graph the
+  // hierarchy was built from, infinity closes an arc. the calling thread is
+  // one of the `num_threads` workers.
+  void customize(std::span<const double> weights,
+                 std::size_t num_threads = thread_pool::default_size());
+
+  // both upward search spaces, walked up the tree without a queue. arguments
+  // and path are node indices.
+  pathfind_result query(std::stop_token token, index_t start, index_t end,
+                        const search_limits &limits = {}) const;
+
+  // the edge {a, b}, `no_edge` if there is none
+  std::size_t find_edge(index_t a, index_t b) const;
+
+  // appends the ranks of the shortest path `tail -> head` the edge between
+  // them stands for, excluding `tail`
+  void unpack(index_t tail, index_t head, std::vector<index_t> &out) const;
+};
+} // namespace mapapp
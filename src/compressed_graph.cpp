@@ -0,0 +1,153 @@
+#include "compressed_graph.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+namespace mapapp {
+namespace {
+using index_t = osm_graph::index_t;
+
+// traffic can only pass through `v`: one way in and one way out, or both ways
+// along the same two neighbours
+bool passes_through(const osm_graph &graph, index_t v) {
+  const auto &out = graph.nodes[v].adj;
+  const auto &in = graph.nodes[v].radj;
+  if (out.size() == 1 && in.size() == 1) {
+    return out[0].second != in[0].second && out[0].second != v &&
+           in[0].second != v;
+  }
+  if (out.size() == 2 && in.size() == 2) {
+    auto a = out[0].second, b = out[1].second;
+    return a != b && a != v && b != v &&
+           ((in[0].second == a && in[1].second == b) ||
+            (in[0].second == b && in[1].second == a));
+  }
+  return false;
+}
+
+// follows the run that starts with `arc` out of `tail` up to the next node for
+// which `is_end` holds, calling `visit` on every node in between. returns the
+// summed weight and the node the run ends at.
+std::pair<double, index_t> follow_run(const osm_graph &graph, index_t tail,
+                                      const std::pair<double, index_t> &arc,
+                                      auto is_end, auto visit) {
+  auto [total, cur] = arc;
+  auto prev = tail;
+  while (!is_end(cur)) {
+    visit(cur);
+    const auto &out = graph.nodes[cur].adj;
+    const auto &next =
+        out.size() == 1 || out[0].second != prev ? out[0] : out[1];
+    total += next.first;
+    prev = cur;
+    cur = next.second;
+  }
+  return {total, cur};
+}
+} // namespace
+
+struct compressed_graph::folded {
+  osm_graph::node_vector nodes;
+  std::vector<index_t> original, junction;
+  std::vector<std::vector<std::pair<std::size_t, std::size_t>>> arc_runs;
+  std::vector<index_t> runs;
+};
+
+compressed_graph::folded compressed_graph::fold(const osm_graph &full) {
+  const auto n = full.nodes.size();
+  folded parts;
+
+  std::vector<bool> kept(n), reached(n);
+  for (index_t v = 0; v < n; ++v) {
+    kept[v] = !passes_through(full, v);
+  }
+  auto is_kept = [&](index_t v) { return kept[v]; };
+  auto reach_from = [&](index_t v) {
+    reached[v] = true;
+    for (const auto &arc : full.nodes[v].adj) {
+      follow_run(full, v, arc, is_kept, [&](index_t w) { reached[w] = true; });
+    }
+  };
+  for (index_t v = 0; v < n; ++v) {
+    if (kept[v]) {
+      reach_from(v);
+    }
+  }
+  // runs that close on themselves have no junction to start from, one node of
+  // each is kept
+  for (index_t v = 0; v < n; ++v) {
+    if (!reached[v]) {
+      kept[v] = true;
+      reach_from(v);
+    }
+  }
+
+  parts.junction.assign(n, none);
+  for (index_t v = 0; v < n; ++v) {
+    if (kept[v]) {
+      parts.junction[v] = parts.original.size();
+      parts.original.push_back(v);
+      auto &node = parts.nodes.emplace_back();
+      node.id = full.nodes[v].id;
+      node.location = full.nodes[v].location;
+      node.position = full.nodes[v].position;
+    }
+  }
+
+  // (weight, head, first, last) per junction, sorted like `adj` so that the
+  // runs stay aligned with it
+  std::vector<std::tuple<double, index_t, std::size_t, std::size_t>> arcs;
+  parts.arc_runs.resize(parts.original.size());
+  for (index_t u = 0; u < parts.original.size(); ++u) {
+    arcs.clear();
+    auto tail = parts.original[u];
+    for (const auto &arc : full.nodes[tail].adj) {
+      auto first = parts.runs.size();
+      auto [weight, head] = follow_run(
+          full, tail, arc, is_kept,
+          [&](index_t v) { parts.runs.push_back(v); });
+      if (head == tail) {
+        // a loop back to the same junction is never part of a path
+        parts.runs.resize(first);
+        continue;
+      }
+      arcs.emplace_back(weight, parts.junction[head], first,
+                        parts.runs.size());
+    }
+    std::sort(arcs.begin(), arcs.end());
+    for (auto [weight, head, first, last] : arcs) {
+      parts.nodes[u].adj.emplace_back(weight, head);
+      parts.nodes[head].radj.emplace_back(weight, u);
+      parts.arc_runs[u].emplace_back(first, last);
+    }
+  }
+  return parts;
+}
+
+compressed_graph::compressed_graph(const osm_graph &full)
+    : compressed_graph{full, fold(full)} {}
+
+compressed_graph::compressed_graph(const osm_graph &full, folded &&parts)
+    : full{full}, graph{std::move(parts.nodes), full.max_speed},
+      original{std::move(parts.original)},
+      junction{std::move(parts.junction)},
+      arc_runs{std::move(parts.arc_runs)}, runs{std::move(parts.runs)} {}
+
+void compressed_graph::unpack(pathfind_result &result) const {
+  std::vector<index_t> path;
+  for (std::size_t i = 0; i < result.path.size(); ++i) {
+    auto head = result.path[i];
+    path.push_back(original[head]);
+    if (i + 1 == result.path.size()) {
+      break;
+    }
+    // the path runs from end to start, so the arc is path[i + 1] -> path[i]
+    auto tail = result.path[i + 1];
+    auto [first, last] = arc_runs[tail][graph.find_arc(tail, head)];
+    for (auto k = last; k-- > first;) {
+      path.push_back(runs[k]);
+    }
+  }
+  result.path = std::move(path);
+}
+} // namespace mapapp
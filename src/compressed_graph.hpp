@@ -0,0 +1,44 @@
+#pragma once
+
+#include "pathfind.hpp"
+#include <vector>
+
+namespace mapapp {
+// the road network with only its junctions. most nodes of `osm_graph` only
+// describe the shape of a road: two neighbours, traffic passing straight
+// through. every run of them is folded into one arc between the junctions at
+// its ends, weighted by the sum of its arcs. any search runs unchanged on
+// `graph` as long as both ends of the query are junctions; `unpack` turns its
+// path back into a path of the full graph.
+struct compressed_graph {
+  using index_t = osm_graph::index_t;
+  static constexpr auto none = static_cast<index_t>(-1);
+
+  const osm_graph &full;
+  // junctions only, in the order of `full`. `nn_query` snaps to junctions.
+  osm_graph graph;
+  // full-graph index of each junction
+  std::vector<index_t> original;
+  // junction index of each full-graph node, `none` inside a run
+  std::vector<index_t> junction;
+
+  explicit compressed_graph(const osm_graph &full);
+  compressed_graph(const compressed_graph &) = delete;
+  auto operator=(const compressed_graph &) = delete;
+
+  // `result.path` from junction indices to full-graph indices, restoring the
+  // nodes folded into each arc. the distance does not change.
+  void unpack(pathfind_result &result) const;
+
+private:
+  struct folded;
+
+  compressed_graph(const osm_graph &full, folded &&parts);
+  static folded fold(const osm_graph &full);
+
+  // nodes folded into each arc of `graph`, aligned with `adj`: the range
+  // `[first, last)` of `runs` holds them from tail to head
+  std::vector<std::vector<std::pair<std::size_t, std::size_t>>> arc_runs;
+  std::vector<index_t> runs;
+};
+} // namespace mapapp
@@ -0,0 +1,404 @@
+#include "contraction.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <functional>
+#include <limits>
+#include <tuple>
+
+namespace mapapp {
+namespace {
+using index_t = osm_graph::index_t;
+constexpr auto infinity = std::numeric_limits<double>::infinity();
+constexpr auto no_node = contraction_hierarchy::no_node;
+
+struct dynamic_arc {
+  double weight;
+  index_t target;
+  index_t middle;
+};
+
+// keeps at most one arc per target, the lightest one
+void add_arc(std::vector<dynamic_arc> &arcs, double weight, index_t target,
+             index_t middle) {
+  for (auto &arc : arcs) {
+    if (arc.target == target) {
+      if (weight < arc.weight) {
+        arc.weight = weight;
+        arc.middle = middle;
+      }
+      return;
+    }
+  }
+  arcs.push_back({weight, target, middle});
+}
+
+// the remaining graph while contracting, in node index space
+struct contraction_graph {
+  std::vector<std::vector<dynamic_arc>> out, in;
+  std::vector<bool> contracted;
+  std::vector<int> deleted_neighbors;
+
+  // witness search workspace
+  std::vector<double> dist;
+  std::vector<index_t> touched;
+  std::vector<std::pair<double, index_t>> queue;
+
+  // priorities are only estimates, so their witness searches are cheaper
+  static constexpr std::size_t max_witness_settled = 500;
+  static constexpr std::size_t max_estimate_settled = 50;
+
+  contraction_graph(const osm_graph &graph)
+      : out(graph.nodes.size()), in(graph.nodes.size()),
+        contracted(graph.nodes.size()),
+        deleted_neighbors(graph.nodes.size()),
+        dist(graph.nodes.size(), infinity) {
+    for (index_t u = 0; u < graph.nodes.size(); ++u) {
+      for (const auto &[weight, v] : graph.nodes[u].adj) {
+        if (u != v) {
+          add_arc(out[u], weight, v, no_node);
+          add_arc(in[v], weight, u, no_node);
+        }
+      }
+    }
+  }
+
+  // local dijkstra from `source` avoiding `excluded`, bounded by distance and
+  // settled node count. labels left in `dist` are upper bounds.
+  void witness_search(index_t source, index_t excluded, double limit,
+                      std::size_t max_settled) {
+    for (auto node : touched) {
+      dist[node] = infinity;
+    }
+    touched.clear();
+    queue.clear();
+
+    dist[source] = 0.0;
+    touched.push_back(source);
+    queue.emplace_back(0.0, source);
+    std::size_t settled = 0;
+    while (!queue.empty()) {
+      std::pop_heap(queue.begin(), queue.end(), std::greater<>{});
+      auto [d, u] = queue.back();
+      queue.pop_back();
+      if (d > dist[u]) {
+        continue;
+      }
+      if (d > limit || ++settled > max_settled) {
+        break;
+      }
+      for (const auto &arc : out[u]) {
+        if (contracted[arc.target] || arc.target == excluded) {
+          continue;
+        }
+        auto next_dist = d + arc.weight;
+        if (next_dist < dist[arc.target]) {
+          if (dist[arc.target] == infinity) {
+            touched.push_back(arc.target);
+          }
+          dist[arc.target] = next_dist;
+          queue.emplace_back(next_dist, arc.target);
+          std::push_heap(queue.begin(), queue.end(), std::greater<>{});
+        }
+      }
+    }
+  }
+
+  // calls fn(u, x, weight) for every shortcut u -> x that contracting v needs
+  void for_each_shortcut(index_t v, std::size_t max_settled, auto fn) {
+    double max_out = 0.0;
+    for (const auto &arc : out[v]) {
+      if (!contracted[arc.target]) {
+        max_out = std::max(max_out, arc.weight);
+      }
+    }
+    for (const auto &in_arc : in[v]) {
+      if (contracted[in_arc.target]) {
+        continue;
+      }
+      witness_search(in_arc.target, v, in_arc.weight + max_out, max_settled);
+      for (const auto &out_arc : out[v]) {
+        if (contracted[out_arc.target] || out_arc.target == in_arc.target) {
+          continue;
+        }
+        auto weight = in_arc.weight + out_arc.weight;
+        if (dist[out_arc.target] > weight) {
+          fn(in_arc.target, out_arc.target, weight);
+        }
+      }
+    }
+  }
+
+  // edge difference with shortcuts counted twice, plus the number of already
+  // contracted neighbours to spread contraction uniformly over the graph
+  int priority(index_t v) {
+    int shortcuts = 0;
+    for_each_shortcut(v, max_estimate_settled, [&](auto...) { ++shortcuts; });
+    int degree = 0;
+    for (const auto &arc : out[v]) {
+      degree += !contracted[arc.target];
+    }
+    for (const auto &arc : in[v]) {
+      degree += !contracted[arc.target];
+    }
+    return 4 * (2 * shortcuts - degree) + deleted_neighbors[v];
+  }
+};
+
+// the arc `tail -> head` stored at the lower ranked endpoint
+const contraction_hierarchy::arc &find_arc(const contraction_hierarchy &ch,
+                                           index_t tail, index_t head) {
+  auto arcs = tail < head ? ch.up(tail) : ch.down(head);
+  auto other = tail < head ? head : tail;
+  auto it = std::find_if(arcs.begin(), arcs.end(),
+                         [&](const auto &arc) { return arc.head == other; });
+  assert(it != arcs.end());
+  return *it;
+}
+} // namespace
+
+contraction_hierarchy::contraction_hierarchy(const osm_graph &graph)
+    : graph{graph} {
+  const auto n = graph.nodes.size();
+  contraction_graph g{graph};
+
+  std::vector<int> priority(n);
+  std::vector<std::pair<int, index_t>> heap;
+  for (index_t v = 0; v < n; ++v) {
+    heap.emplace_back(priority[v] = g.priority(v), v);
+  }
+  std::make_heap(heap.begin(), heap.end(), std::greater<>{});
+
+  rank.assign(n, no_node);
+  node.reserve(n);
+  // final arcs of every node in node index space, all to higher ranks
+  std::vector<std::vector<dynamic_arc>> up_tmp(n), down_tmp(n);
+  std::vector<std::tuple<index_t, index_t, double>> shortcuts;
+  std::vector<index_t> neighbors;
+
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), std::greater<>{});
+    auto [p, v] = heap.back();
+    heap.pop_back();
+    if (g.contracted[v] || p != priority[v]) {
+      continue;
+    }
+
+    // lazy update: contract only if v is still the minimum
+    priority[v] = g.priority(v);
+    if (!heap.empty() && priority[v] > heap.front().first) {
+      heap.emplace_back(priority[v], v);
+      std::push_heap(heap.begin(), heap.end(), std::greater<>{});
+      continue;
+    }
+
+    rank[v] = node.size();
+    node.push_back(v);
+
+    neighbors.clear();
+    for (const auto &arc : g.out[v]) {
+      if (!g.contracted[arc.target]) {
+        up_tmp[v].push_back(arc);
+        neighbors.push_back(arc.target);
+      }
+    }
+    for (const auto &arc : g.in[v]) {
+      if (!g.contracted[arc.target]) {
+        down_tmp[v].push_back(arc);
+        neighbors.push_back(arc.target);
+      }
+    }
+
+    shortcuts.clear();
+    g.for_each_shortcut(v, contraction_graph::max_witness_settled,
+                        [&](index_t u, index_t x, double weight) {
+                          shortcuts.emplace_back(u, x, weight);
+                        });
+    for (auto [u, x, weight] : shortcuts) {
+      add_arc(g.out[u], weight, x, v);
+      add_arc(g.in[x], weight, u, v);
+    }
+    num_shortcuts += shortcuts.size();
+    g.contracted[v] = true;
+
+    std::sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(std::unique(neighbors.begin(), neighbors.end()),
+                    neighbors.end());
+    for (auto neighbor : neighbors) {
+      auto is_v = [&](const auto &arc) { return arc.target == v; };
+      std::erase_if(g.out[neighbor], is_v);
+      std::erase_if(g.in[neighbor], is_v);
+      ++g.deleted_neighbors[neighbor];
+      heap.emplace_back(priority[neighbor] = g.priority(neighbor), neighbor);
+      std::push_heap(heap.begin(), heap.end(), std::greater<>{});
+    }
+  }
+
+  auto build_csr = [&](const auto &tmp, auto &first, auto &arcs) {
+    first.reserve(n + 1);
+    for (index_t r = 0; r < n; ++r) {
+      first.push_back(arcs.size());
+      for (const auto &arc : tmp[node[r]]) {
+        arcs.push_back({arc.weight, rank[arc.target],
+                        arc.middle == no_node ? no_node : rank[arc.middle]});
+      }
+    }
+    first.push_back(arcs.size());
+  };
+  build_csr(up_tmp, up_first, up_arcs);
+  build_csr(down_tmp, down_first, down_arcs);
+}
+
+void contraction_hierarchy::unpack(index_t tail, index_t head, index_t middle,
+                                   std::vector<index_t> &out) const {
+  if (middle == no_node) {
+    out.push_back(head);
+    return;
+  }
+  unpack(tail, middle, find_arc(*this, tail, middle).middle, out);
+  unpack(middle, head, find_arc(*this, middle, head).middle, out);
+}
+
+pathfind_result
+contraction_hierarchy::query(std::stop_token token, index_t start, index_t end,
+                             const search_limits &limits) const {
+  pathfind_result result;
+  search_control control{token, limits, &result.mem_stat};
+  if (!graph.may_reach(start, end)) {
+    return result;
+  }
+
+  // rank -> (distance, parent rank)
+  using labels_t = pf_map<index_t, std::pair<double, index_t>>;
+  using queue_t = pf_vector<std::pair<double, index_t>>;
+  std::array<labels_t, 2> labels{labels_t{&result.mem_stat},
+                                 labels_t{&result.mem_stat}};
+  std::array<queue_t, 2> queues{queue_t{&result.mem_stat},
+                                queue_t{&result.mem_stat}};
+
+  const std::array<index_t, 2> sources{rank[start], rank[end]};
+  for (int side = 0; side < 2; ++side) {
+    labels[side][sources[side]] = {0.0, no_node};
+    queues[side].emplace_back(0.0, sources[side]);
+  }
+
+  auto best = infinity;
+  auto meet = no_node;
+  while (true) {
+    auto top = [&](int side) {
+      return queues[side].empty() ? infinity : queues[side].front().first;
+    };
+    // both searches only go upward, so neither can improve past `best`
+    if (std::min(top(0), top(1)) >= best) {
+      break;
+    }
+
+    int side = top(0) <= top(1) ? 0 : 1;
+    auto &queue = queues[side];
+    std::pop_heap(queue.begin(), queue.end(), std::greater<>{});
+    auto [dist, cur] = queue.back();
+    queue.pop_back();
+    if (dist > labels[side][cur].first) {
+      continue;
+    }
+    if (control.expand()) {
+      break;
+    }
+    result.counters.settle();
+    control.settle(node[cur]);
+
+    if (auto it = labels[1 - side].find(cur); it != labels[1 - side].end()) {
+      if (dist + it->second.first < best) {
+        best = dist + it->second.first;
+        meet = cur;
+      }
+    }
+
+    for (const auto &arc : side == 0 ? up(cur) : down(cur)) {
+      auto next_dist = dist + arc.weight;
+      auto [it, inserted] =
+          labels[side].try_emplace(arc.head, next_dist, cur);
+      if (inserted || next_dist < it->second.first) {
+        it->second = {next_dist, cur};
+        queue.emplace_back(next_dist, arc.head);
+        std::push_heap(queue.begin(), queue.end(), std::greater<>{});
+      }
+    }
+  }
+
+  result.stopped = control.stopped();
+  if (meet == no_node || result.stopped) {
+    return result;
+  }
+
+  std::vector<index_t> forward{meet};
+  while (forward.back() != sources[0]) {
+    forward.push_back(labels[0].at(forward.back()).second);
+  }
+  std::reverse(forward.begin(), forward.end());
+
+  std::vector<index_t> ranks{forward.front()};
+  for (std::size_t i = 0; i + 1 < forward.size(); ++i) {
+    unpack(forward[i], forward[i + 1],
+           find_arc(*this, forward[i], forward[i + 1]).middle, ranks);
+  }
+  for (auto cur = meet; cur != sources[1];) {
+    auto next = labels[1].at(cur).second;
+    unpack(cur, next, find_arc(*this, cur, next).middle, ranks);
+    cur = next;
+  }
+
+  // unpacked from `start`, returned from `end`
+  result.path.reserve(ranks.size());
+  for (auto it = ranks.rbegin(); it != ranks.rend(); ++it) {
+    result.path.push_back(node[*it]);
+  }
+  result.distance = best;
+  return result;
+}
+
+template <std::size_t lanes>
+void phast<lanes>::run(std::span<const osm_graph::index_t> sources) {
+  assert(sources.size() <= lanes);
+  distance.assign(ch.size() * lanes, infinity);
+
+  for (std::size_t lane = 0; lane < sources.size(); ++lane) {
+    auto source = ch.rank[sources[lane]];
+    distance[source * lanes + lane] = 0.0;
+    queue.clear();
+    queue.emplace_back(0.0, source);
+    while (!queue.empty()) {
+      std::pop_heap(queue.begin(), queue.end(), std::greater<>{});
+      auto [dist, cur] = queue.back();
+      queue.pop_back();
+      if (dist > distance[cur * lanes + lane]) {
+        continue;
+      }
+      for (const auto &arc : ch.up(cur)) {
+        auto &label = distance[arc.head * lanes + lane];
+        if (dist + arc.weight < label) {
+          label = dist + arc.weight;
+          queue.emplace_back(label, arc.head);
+          std::push_heap(queue.begin(), queue.end(), std::greater<>{});
+        }
+      }
+    }
+  }
+
+  // every arc into r comes from a higher rank, which is already final
+  for (auto r = ch.size(); r-- > 0;) {
+    auto *dist_r = &distance[r * lanes];
+    for (const auto &arc : ch.down(r)) {
+      const auto *dist_u = &distance[arc.head * lanes];
+      for (std::size_t lane = 0; lane < lanes; ++lane) {
+        dist_r[lane] = std::min(dist_r[lane], dist_u[lane] + arc.weight);
+      }
+    }
+  }
+}
+
+template struct phast<1>;
+template struct phast<4>;
+template struct phast<8>;
+} // namespace mapapp
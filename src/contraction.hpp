@@ -0,0 +1,78 @@
+#pragma once
+
+#include "pathfind.hpp"
+#include <span>
+#include <stop_token>
+#include <vector>
+
+namespace mapapp {
+// contraction hierarchy over `osm_graph`. nodes are renumbered by rank
+// (contraction order), every arc goes from a lower to a higher rank and is
+// stored at its lower endpoint: outgoing arcs in `up`, incoming ones in `down`.
+struct contraction_hierarchy {
+  using index_t = osm_graph::index_t;
+  static constexpr auto no_node = static_cast<index_t>(-1);
+
+  const osm_graph &graph;
+
+  struct arc {
+    double weight;
+    // rank of the other endpoint
+    index_t head;
+    // rank of the contracted node a shortcut bypasses, `no_node` for arcs of
+    // the original graph
+    index_t middle = no_node;
+  };
+
+  // rank of every node index, and the node index of every rank
+  std::vector<index_t> rank, node;
+  std::vector<std::size_t> up_first, down_first;
+  std::vector<arc> up_arcs, down_arcs;
+  std::size_t num_shortcuts = 0;
+
+  contraction_hierarchy(const osm_graph &graph);
+
+  std::size_t size() const { return node.size(); }
+  std::span<const arc> up(index_t r) const {
+    return {up_arcs.data() + up_first[r], up_arcs.data() + up_first[r + 1]};
+  }
+  // arcs u -> r of the (augmented) graph with rank u > r, `head` is u
+  std::span<const arc> down(index_t r) const {
+    return {down_arcs.data() + down_first[r],
+            down_arcs.data() + down_first[r + 1]};
+  }
+
+  // bidirectional upward search, arguments and path are node indices
+  pathfind_result query(std::stop_token token, index_t start, index_t end,
+                        const search_limits &limits = {}) const;
+
+  // appends the ranks of the original path of the arc `tail -> head`,
+  // excluding `tail`
+  void unpack(index_t tail, index_t head, index_t middle,
+              std::vector<index_t> &out) const;
+};
+
+// PHAST one-to-all: an upward search from every source followed by a single
+// linear sweep over the nodes in decreasing rank. `lanes` sources share a
+// sweep; their labels are interleaved so the innermost loop is a fixed-width
+// min/add over contiguous doubles that the compiler vectorizes.
+template <std::size_t lanes> struct phast {
+  const contraction_hierarchy &ch;
+  // indexed by rank * lanes + lane
+  std::vector<double> distance;
+  std::vector<std::pair<double, osm_graph::index_t>> queue;
+
+  phast(const contraction_hierarchy &ch) : ch{ch} {}
+
+  // at most `lanes` node indices, unused lanes stay unreached
+  void run(std::span<const osm_graph::index_t> sources);
+
+  double operator()(std::size_t lane, osm_graph::index_t node) const {
+    return distance[ch.rank[node] * lanes + lane];
+  }
+};
+
+extern template struct phast<1>;
+extern template struct phast<4>;
+extern template struct phast<8>;
+} // namespace mapapp
@@ -0,0 +1,177 @@
+#include "delta_stepping.hpp"
+
+#include <algorithm>
+#include <barrier>
+#include <thread>
+
+namespace mapapp {
+delta_stepping::delta_stepping(const osm_graph &graph, double delta)
+    : graph{graph}, delta{delta}, distance(graph.nodes.size()),
+      relaxed_at(graph.nodes.size()), heavy_queued(graph.nodes.size()) {
+  if (this->delta > 0.0) {
+    return;
+  }
+  double total = 0.0;
+  std::size_t arcs = 0;
+  for (const auto &vertex : graph.nodes) {
+    for (const auto &[weight, next] : vertex.adj) {
+      total += weight;
+    }
+    arcs += vertex.adj.size();
+  }
+  // a few arcs per bucket: wide enough that rounds have work to share, narrow
+  // enough that few nodes are relaxed before their label is final
+  this->delta = arcs == 0 ? 1.0 : 4.0 * total / arcs;
+}
+
+void delta_stepping::run(std::stop_token token, index_t source,
+                         std::size_t num_threads) {
+  constexpr auto none = static_cast<std::size_t>(-1);
+  // nodes claimed at once from the shared round
+  constexpr std::size_t chunk = 64;
+
+  num_threads = std::max<std::size_t>(num_threads, 1);
+  workers.resize(num_threads);
+
+  // current bucket, chosen as the lowest nonempty bucket of all workers
+  std::size_t bucket = 0;
+  std::atomic<std::size_t> next_bucket{none};
+  auto select = [&]() noexcept {
+    bucket = token.stop_requested() ? none : next_bucket.load();
+    next_bucket = none;
+  };
+
+  // the round is the concatenation of every worker's `round`
+  std::vector<std::size_t> round_first(num_threads + 1);
+  std::atomic<std::size_t> cursor;
+  auto gather = [&]() noexcept {
+    for (std::size_t i = 0; i < num_threads; ++i) {
+      round_first[i + 1] = round_first[i] + workers[i].round.size();
+    }
+    if (token.stop_requested()) {
+      std::fill(round_first.begin(), round_first.end(), 0);
+    }
+    cursor = 0;
+  };
+
+  std::barrier select_sync{static_cast<std::ptrdiff_t>(num_threads), select};
+  std::barrier gather_sync{static_cast<std::ptrdiff_t>(num_threads), gather};
+  std::barrier round_sync{static_cast<std::ptrdiff_t>(num_threads)};
+
+  auto relax = [&](worker &self, index_t node, double dist) {
+    auto &label = distance[node];
+    auto old = label.load(std::memory_order_relaxed);
+    while (dist < old) {
+      if (label.compare_exchange_weak(old, dist, std::memory_order_relaxed)) {
+        auto b = static_cast<std::size_t>(dist / delta);
+        if (b >= self.buckets.size()) {
+          self.buckets.resize(b + 1);
+        }
+        self.buckets[b].push_back(node);
+        return;
+      }
+    }
+  };
+
+  auto is_light = [&](const auto &arc) { return arc.first <= delta; };
+
+  auto work = [&](std::size_t id) {
+    auto &self = workers[id];
+    const auto num_nodes = graph.nodes.size();
+    for (auto node = num_nodes * id / num_threads;
+         node < num_nodes * (id + 1) / num_threads; ++node) {
+      distance[node].store(shortest_path_tree::unreached,
+                           std::memory_order_relaxed);
+      relaxed_at[node].store(shortest_path_tree::unreached,
+                             std::memory_order_relaxed);
+      heavy_queued[node].store(false, std::memory_order_relaxed);
+    }
+    for (auto &nodes : self.buckets) {
+      nodes.clear();
+    }
+    self.settled.clear();
+    round_sync.arrive_and_wait();
+    if (id == 0) {
+      relax(self, source, 0.0);
+    }
+
+    // every bucket of this worker below `b` is empty
+    std::size_t b = 0;
+    while (true) {
+      while (b < self.buckets.size() && self.buckets[b].empty()) {
+        ++b;
+      }
+      if (b < self.buckets.size()) {
+        auto lowest = next_bucket.load(std::memory_order_relaxed);
+        while (b < lowest &&
+               !next_bucket.compare_exchange_weak(lowest, b,
+                                                  std::memory_order_relaxed)) {
+        }
+      }
+      select_sync.arrive_and_wait();
+      if (bucket == none) {
+        break;
+      }
+      b = bucket;
+
+      // light arcs, until no label in the bucket drops any more
+      while (true) {
+        self.round.clear();
+        if (b < self.buckets.size()) {
+          std::swap(self.round, self.buckets[b]);
+        }
+        gather_sync.arrive_and_wait();
+        const auto round_size = round_first.back();
+        if (round_size == 0) {
+          break;
+        }
+
+        std::size_t first;
+        while ((first = cursor.fetch_add(chunk, std::memory_order_relaxed)) <
+               round_size) {
+          std::size_t owner = 0;
+          for (auto i = first; i < std::min(first + chunk, round_size); ++i) {
+            while (i >= round_first[owner + 1]) {
+              ++owner;
+            }
+            auto node = workers[owner].round[i - round_first[owner]];
+            auto dist = distance[node].load(std::memory_order_relaxed);
+            if (relaxed_at[node].exchange(dist, std::memory_order_relaxed) ==
+                dist) {
+              continue;
+            }
+            if (!heavy_queued[node].exchange(true,
+                                             std::memory_order_relaxed)) {
+              self.settled.push_back(node);
+            }
+            const auto &adj = graph.nodes[node].adj;
+            // arcs are sorted by weight, the light ones come first
+            for (auto it = adj.begin(); it != adj.end() && is_light(*it);
+                 ++it) {
+              relax(self, it->second, dist + it->first);
+            }
+          }
+        }
+        round_sync.arrive_and_wait();
+      }
+
+      // the labels of the bucket are final, heavy arcs lead past it
+      for (auto node : self.settled) {
+        auto dist = distance[node].load(std::memory_order_relaxed);
+        const auto &adj = graph.nodes[node].adj;
+        for (auto it = std::partition_point(adj.begin(), adj.end(), is_light);
+             it != adj.end(); ++it) {
+          relax(self, it->second, dist + it->first);
+        }
+      }
+      self.settled.clear();
+    }
+  };
+
+  std::vector<std::jthread> helpers;
+  for (std::size_t id = 1; id < num_threads; ++id) {
+    helpers.emplace_back(work, id);
+  }
+  work(0);
+}
+} // namespace mapapp
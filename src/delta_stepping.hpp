@@ -0,0 +1,52 @@
+#pragma once
+
+#include "pathfind.hpp"
+#include <atomic>
+#include <stop_token>
+#include <vector>
+
+namespace mapapp {
+// parallel one-to-all by delta-stepping (Meyer & Sanders). nodes wait in
+// buckets of width `delta` by tentative distance. the lowest nonempty bucket is
+// emptied in rounds that relax light arcs (weight <= delta) until no node
+// re-enters it, then the heavy arcs of every node it settled are relaxed once.
+// labels are lowered with compare-and-swap and every thread fills only its own
+// buckets, so threads meet at a barrier once per round and never lock.
+struct delta_stepping {
+  using index_t = osm_graph::index_t;
+
+  const osm_graph &graph;
+  double delta;
+  std::vector<std::atomic<double>> distance;
+
+  // `delta` <= 0 picks a width from the mean arc weight
+  delta_stepping(const osm_graph &graph, double delta = 0.0);
+
+  // labels equal those of `ucs_one_to_all` without a budget, or are upper
+  // bounds if `token` stops the search early. the calling thread is one of the
+  // `num_threads` workers.
+  void run(std::stop_token token, index_t source, std::size_t num_threads);
+
+  double operator[](index_t node) const {
+    return distance[node].load(std::memory_order_relaxed);
+  }
+
+private:
+  struct worker {
+    // node indices by bucket number, a node is added again whenever its label
+    // drops
+    std::vector<std::vector<index_t>> buckets;
+    // this worker's share of the current round, the bucket that was emptied
+    // into it is refilled by the round itself
+    std::vector<index_t> round;
+    // nodes whose light arcs this worker relaxed in the current bucket
+    std::vector<index_t> settled;
+  };
+
+  // label each node's light arcs were last relaxed with, skips duplicates
+  std::vector<std::atomic<double>> relaxed_at;
+  // set when a node is first added to some worker's `settled`
+  std::vector<std::atomic<bool>> heavy_queued;
+  std::vector<worker> workers;
+};
+} // namespace mapapp
@@ -0,0 +1,68 @@
+#include "frontier_renderer.hpp"
+
+namespace mapapp {
+frontier_renderer::frontier_renderer() {
+  vao = vertex_array::create();
+  vbo = buffer::create();
+  shd = load_vf_shader({R"(
+#version 330
+layout(location = 0) in vec2 pos;
+uniform vec2 translation;
+uniform vec2 scale;
+void main() {
+  gl_Position = vec4(scale * (pos + translation), 0.0, 1.0);
+}
+)",
+                        R"(
+#version 330
+out vec4 out_color;
+uniform vec4 color;
+void main() {
+  out_color = color;
+}
+)"});
+  loc_translation = glGetUniformLocation(shd, "translation");
+  loc_scale = glGetUniformLocation(shd, "scale");
+  loc_color = glGetUniformLocation(shd, "color");
+
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, false, sizeof(glm::vec2), nullptr);
+}
+
+void frontier_renderer::append(std::span<const glm::vec2> new_points) {
+  if (new_points.empty()) {
+    return;
+  }
+  auto offset = points.size();
+  points.insert(points.end(), new_points.begin(), new_points.end());
+
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  if (points.size() > capacity) {
+    capacity = std::max(points.size(), capacity * 2);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::vec2), nullptr,
+                 GL_DYNAMIC_DRAW);
+    offset = 0;
+  }
+  glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(glm::vec2),
+                  (points.size() - offset) * sizeof(glm::vec2),
+                  points.data() + offset);
+}
+
+void frontier_renderer::reset() { points.clear(); }
+
+void frontier_renderer::render(const camera::transform &transform,
+                               nk_colorf color) {
+  if (points.empty()) {
+    return;
+  }
+  glUseProgram(shd);
+  glUniform2fv(loc_translation, 1, &transform.translation[0]);
+  glUniform2fv(loc_scale, 1, &transform.scale[0]);
+  glUniform4fv(loc_color, 1, &color.r);
+  glPointSize(point_size);
+  glBindVertexArray(vao);
+  glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(points.size()));
+}
+} // namespace mapapp
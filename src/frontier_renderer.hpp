@@ -0,0 +1,31 @@
+#pragma once
+
+#include "camera.hpp"
+#include "gl.hpp"
+#include "nk.h"
+#include <glad/gl.h>
+#include <glm/vec2.hpp>
+#include <span>
+#include <vector>
+
+namespace mapapp {
+// a growing point cloud in one color, e.g. the nodes settled by a search.
+// points are appended to the end of the GPU buffer, which only has to be
+// reallocated when it runs out of room.
+struct frontier_renderer {
+  vertex_array vao;
+  buffer vbo;
+  shader shd;
+  GLint loc_translation, loc_scale, loc_color;
+  // every point so far, kept to refill the buffer when it grows
+  std::vector<glm::vec2> points;
+  std::size_t capacity = 0;
+  float point_size = 3.0f;
+
+  frontier_renderer();
+
+  void append(std::span<const glm::vec2> new_points);
+  void reset();
+  void render(const camera::transform &transform, nk_colorf color);
+};
+} // namespace mapapp
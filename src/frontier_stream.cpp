@@ -0,0 +1,30 @@
+#include "frontier_stream.hpp"
+
+namespace mapapp {
+namespace {
+thread_local frontier_stream *current_stream = nullptr;
+} // namespace
+
+frontier_stream::scope::scope(frontier_stream &stream)
+    : previous{current_stream} {
+  current_stream = &stream;
+}
+
+frontier_stream::scope::~scope() { current_stream = previous; }
+
+frontier_stream::frontier_stream(std::size_t capacity) : ring{capacity} {}
+
+void frontier_stream::flush() {
+  ring.push({batch.data(), batch_size});
+  batch_size = 0;
+}
+
+void frontier_stream::drain(std::vector<std::size_t> &out) {
+  std::array<std::size_t, 1024> chunk;
+  while (auto n = ring.pop(chunk)) {
+    out.insert(out.end(), chunk.begin(), chunk.begin() + n);
+  }
+}
+
+frontier_stream *current_frontier_stream() { return current_stream; }
+} // namespace mapapp
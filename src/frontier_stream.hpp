@@ -0,0 +1,50 @@
+#pragma once
+
+#include "spsc_ring.hpp"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace mapapp {
+// node indices settled by a running search, handed to the render loop in
+// batches. the search thread is the only producer, the render loop the only
+// consumer. nodes that do not fit while the consumer lags behind are dropped.
+class frontier_stream {
+public:
+  // while alive, searches started on this thread publish into `stream`
+  class scope {
+  public:
+    explicit scope(frontier_stream &stream);
+    ~scope();
+    scope(const scope &) = delete;
+    auto operator=(const scope &) = delete;
+
+  private:
+    frontier_stream *previous;
+  };
+
+  explicit frontier_stream(std::size_t capacity = std::size_t{1} << 17);
+  frontier_stream(const frontier_stream &) = delete;
+  auto operator=(const frontier_stream &) = delete;
+
+  // search thread
+  void publish(std::size_t node) {
+    batch[batch_size++] = node;
+    if (batch_size == batch.size()) {
+      flush();
+    }
+  }
+  void flush();
+
+  // render loop: appends everything published so far
+  void drain(std::vector<std::size_t> &out);
+
+private:
+  spsc_ring<std::size_t> ring;
+  std::array<std::size_t, 256> batch;
+  std::size_t batch_size = 0;
+};
+
+// the stream of the innermost live `frontier_stream::scope` on this thread
+frontier_stream *current_frontier_stream();
+} // namespace mapapp
@@ -0,0 +1,421 @@
+#include "hub_labels.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mapapp {
+namespace {
+using index_t = osm_graph::index_t;
+using hub_t = hub_labels::hub_t;
+constexpr auto infinity = std::numeric_limits<double>::infinity();
+constexpr std::string_view magic = "mapapp-hub-lbl";
+constexpr std::uint32_t version = 1;
+// every array of a file starts at a multiple of this
+constexpr std::size_t alignment = 64;
+
+struct entry {
+  hub_t hub;
+  double distance;
+};
+
+// the smallest sum of distances over the common hubs of two sorted labels
+double meet(std::span<const entry> forward, std::span<const entry> backward) {
+  auto best = infinity;
+  for (std::size_t i = 0, j = 0; i < forward.size() && j < backward.size();) {
+    if (forward[i].hub < backward[j].hub) {
+      ++i;
+    } else if (backward[j].hub < forward[i].hub) {
+      ++j;
+    } else {
+      best = std::min(best, forward[i++].distance + backward[j++].distance);
+    }
+  }
+  return best;
+}
+
+struct file_header {
+  char magic[16];
+  std::uint32_t version, block;
+  std::uint64_t num_nodes;
+  // of the graph the labels were built for, see `fingerprint`
+  std::uint64_t fingerprint;
+  // entries of the forward and backward labels, padding included
+  std::uint64_t entries[2];
+};
+
+// FNV-1a over the node ids and the arcs with their weights, anything the
+// labels depend on
+std::uint64_t fingerprint(const osm_graph &graph) {
+  std::uint64_t hash = 14695981039346656037u;
+  auto add = [&](std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+      hash = (hash ^ (value >> (8 * i) & 0xff)) * 1099511628211u;
+    }
+  };
+  for (const auto &node : graph.nodes) {
+    add(static_cast<std::uint64_t>(node.id));
+    for (const auto &[weight, head] : node.adj) {
+      add(head);
+      add(std::bit_cast<std::uint64_t>(weight));
+    }
+  }
+  return hash;
+}
+
+std::size_t align(std::size_t offset) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+// byte offsets in a file of the first, hub and distance arrays of the forward
+// labels, then of the backward ones, then the size of the file
+std::array<std::size_t, 7> layout(const file_header &header) {
+  std::array<std::size_t, 7> offsets;
+  std::size_t offset = sizeof(file_header);
+  for (std::size_t s = 0; s < 2; ++s) {
+    offsets[3 * s] = offset = align(offset);
+    offset += (header.num_nodes + 1) * sizeof(std::uint64_t);
+    offsets[3 * s + 1] = offset = align(offset);
+    offset += header.entries[s] * sizeof(hub_t);
+    offsets[3 * s + 2] = offset = align(offset);
+    offset += header.entries[s] * sizeof(double);
+  }
+  offsets[6] = offset;
+  return offsets;
+}
+
+// `count` values at `offset` of a mapped file. the mapping starts on a page,
+// so `layout` keeps every array aligned.
+template <class T>
+std::span<const T> view(std::span<const std::byte> bytes, std::size_t offset,
+                        std::size_t count) {
+  return {reinterpret_cast<const T *>(bytes.data() + offset), count};
+}
+} // namespace
+
+#ifdef _WIN32
+mapped_file::mapped_file(const std::filesystem::path &path) {
+  file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                     OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  LARGE_INTEGER file_size;
+  if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size)) {
+    if (file != INVALID_HANDLE_VALUE) {
+      CloseHandle(file);
+    }
+    throw std::runtime_error{"cannot open " + path.string()};
+  }
+  size = static_cast<std::size_t>(file_size.QuadPart);
+  if (size == 0) {
+    return;
+  }
+  mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping != nullptr) {
+    data = static_cast<const std::byte *>(
+        MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  }
+  if (data == nullptr) {
+    if (mapping != nullptr) {
+      CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    throw std::runtime_error{"cannot map " + path.string()};
+  }
+}
+
+mapped_file::~mapped_file() {
+  if (data != nullptr) {
+    UnmapViewOfFile(data);
+  }
+  if (mapping != nullptr) {
+    CloseHandle(mapping);
+  }
+  if (file != nullptr) {
+    CloseHandle(file);
+  }
+}
+#else
+mapped_file::mapped_file(const std::filesystem::path &path) {
+  auto fd = open(path.c_str(), O_RDONLY);
+  struct stat status;
+  if (fd < 0 || fstat(fd, &status) != 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    throw std::runtime_error{"cannot open " + path.string()};
+  }
+  size = static_cast<std::size_t>(status.st_size);
+  // the mapping keeps the file, the descriptor is not needed past this
+  void *address = nullptr;
+  if (size > 0) {
+    address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (address == MAP_FAILED) {
+    throw std::runtime_error{"cannot map " + path.string()};
+  }
+  data = static_cast<const std::byte *>(address);
+}
+
+mapped_file::~mapped_file() {
+  if (data != nullptr) {
+    munmap(const_cast<std::byte *>(data), size);
+  }
+}
+#endif
+
+hub_labels::hub_labels(const contraction_hierarchy &ch,
+                       std::size_t num_threads) {
+  const auto n = ch.size();
+  if (n >= no_hub) {
+    throw std::runtime_error{"too many nodes for hub labels"};
+  }
+
+  // height of every rank: 0 without higher neighbours, else one more than
+  // the highest of them. ranks are grouped by height, lowest first.
+  std::vector<std::size_t> height(n, 0), height_first;
+  for (auto r = n; r-- > 0;) {
+    for (auto arcs : {ch.up(r), ch.down(r)}) {
+      for (const auto &arc : arcs) {
+        height[r] = std::max(height[r], height[arc.head] + 1);
+      }
+    }
+    if (height_first.size() < height[r] + 2) {
+      height_first.resize(height[r] + 2, 0);
+    }
+    ++height_first[height[r] + 1];
+  }
+  for (std::size_t h = 1; h < height_first.size(); ++h) {
+    height_first[h] += height_first[h - 1];
+  }
+  std::vector<index_t> by_height(n);
+  {
+    auto next = height_first;
+    for (index_t r = 0; r < n; ++r) {
+      by_height[next[height[r]]++] = r;
+    }
+  }
+
+  // forward, backward, by rank
+  std::array<std::vector<std::vector<entry>>, 2> labels;
+  labels[0].resize(n);
+  labels[1].resize(n);
+
+  // the ranks of a height only read the labels of lower heights, so they
+  // need no locks; a height starts once the one below is done
+  constexpr std::size_t chunk = 64;
+  num_threads = std::max<std::size_t>(num_threads, 1);
+  std::size_t h = 0;
+  const auto num_heights = height_first.empty() ? 0 : height_first.size() - 1;
+  std::atomic<std::size_t> cursor{0};
+  auto next_height = [&]() noexcept {
+    ++h;
+    cursor = 0;
+  };
+  std::barrier height_sync{static_cast<std::ptrdiff_t>(num_threads),
+                           next_height};
+
+  auto work = [&] {
+    // candidate distance of every hub, reset to infinity after each label
+    std::vector<double> best(n, infinity);
+    std::vector<hub_t> touched;
+    std::vector<entry> candidate;
+    auto build = [&](index_t r, std::size_t s) {
+      best[r] = 0.0;
+      touched.push_back(static_cast<hub_t>(r));
+      for (const auto &arc : s == 0 ? ch.up(r) : ch.down(r)) {
+        for (auto [hub, distance] : labels[s][arc.head]) {
+          if (best[hub] == infinity) {
+            touched.push_back(hub);
+          }
+          best[hub] = std::min(best[hub], distance + arc.weight);
+        }
+      }
+      std::sort(touched.begin(), touched.end());
+      candidate.clear();
+      for (auto hub : touched) {
+        candidate.push_back({hub, best[hub]});
+        best[hub] = infinity;
+      }
+      touched.clear();
+
+      // a hub reached no faster than over another one never lies on a
+      // shortest path as its highest node, so it is pruned. the labels of
+      // hubs are done, hubs rank higher.
+      auto &label = labels[s][r];
+      for (const auto &e : candidate) {
+        const auto &other = labels[1 - s][e.hub];
+        if (e.hub == r ||
+            (s == 0 ? meet(candidate, other) : meet(other, candidate)) >=
+                e.distance) {
+          label.push_back(e);
+        }
+      }
+      label.shrink_to_fit();
+    };
+
+    while (h < num_heights) {
+      const auto first = height_first[h], end = height_first[h + 1];
+      for (std::size_t i; (i = first + cursor.fetch_add(chunk)) < end;) {
+        for (auto last = std::min(i + chunk, end); i < last; ++i) {
+          build(by_height[i], 0);
+          build(by_height[i], 1);
+        }
+      }
+      height_sync.arrive_and_wait();
+    }
+  };
+
+  {
+    std::vector<std::jthread> helpers;
+    for (std::size_t id = 1; id < num_threads; ++id) {
+      helpers.emplace_back(work);
+    }
+    work();
+  }
+
+  // node by node, every label padded to whole blocks
+  for (std::size_t s = 0; s < 2; ++s) {
+    auto &[first, hubs, distances] = owned[s];
+    first.reserve(n + 1);
+    first.push_back(0);
+    for (index_t v = 0; v < n; ++v) {
+      auto &label = labels[s][ch.rank[v]];
+      for (auto [hub, distance] : label) {
+        hubs.push_back(hub);
+        distances.push_back(distance);
+      }
+      hubs.resize((hubs.size() + block - 1) / block * block, no_hub);
+      distances.resize(hubs.size(), infinity);
+      first.push_back(hubs.size());
+      label = {};
+    }
+    sides[s] = {first, hubs, distances};
+  }
+}
+
+hub_labels::hub_labels(const std::filesystem::path &path,
+                       const osm_graph &graph)
+    : file{std::make_shared<const mapped_file>(path)} {
+  auto bytes = file->bytes();
+  file_header header;
+  if (bytes.size() < sizeof header) {
+    throw std::runtime_error{"not a hub label file"};
+  }
+  std::memcpy(&header, bytes.data(), sizeof header);
+  if (std::string_view{header.magic} != magic || header.version != version ||
+      header.block != block) {
+    throw std::runtime_error{"not a hub label file"};
+  }
+  if (header.num_nodes != graph.nodes.size() ||
+      header.fingerprint != fingerprint(graph)) {
+    throw std::runtime_error{"hub labels do not fit the graph"};
+  }
+  auto offsets = layout(header);
+  if (bytes.size() != offsets[6]) {
+    throw std::runtime_error{"hub label file is truncated"};
+  }
+  for (std::size_t s = 0; s < 2; ++s) {
+    auto entries = header.entries[s];
+    sides[s] = {
+        view<std::uint64_t>(bytes, offsets[3 * s], header.num_nodes + 1),
+        view<hub_t>(bytes, offsets[3 * s + 1], entries),
+        view<double>(bytes, offsets[3 * s + 2], entries)};
+    if (sides[s].first.back() != entries) {
+      throw std::runtime_error{"hub label file is corrupt"};
+    }
+  }
+}
+
+void hub_labels::save(const std::filesystem::path &path,
+                      const osm_graph &graph) const {
+  file_header header{};
+  std::copy(magic.begin(), magic.end(), header.magic);
+  header.version = version;
+  header.block = block;
+  header.num_nodes = size();
+  header.fingerprint = fingerprint(graph);
+  header.entries[0] = sides[0].hubs.size();
+  header.entries[1] = sides[1].hubs.size();
+  auto offsets = layout(header);
+
+  std::ofstream out{path, std::ios::binary};
+  std::size_t written = 0;
+  auto write = [&](std::size_t offset, const void *data, std::size_t bytes) {
+    static constexpr char zeros[alignment]{};
+    out.write(zeros, static_cast<std::streamsize>(offset - written));
+    out.write(static_cast<const char *>(data),
+              static_cast<std::streamsize>(bytes));
+    written = offset + bytes;
+  };
+  write(0, &header, sizeof header);
+  for (std::size_t s = 0; s < 2; ++s) {
+    const auto &[first, hubs, distances] = sides[s];
+    write(offsets[3 * s], first.data(), first.size_bytes());
+    write(offsets[3 * s + 1], hubs.data(), hubs.size_bytes());
+    write(offsets[3 * s + 2], distances.data(), distances.size_bytes());
+  }
+  if (!out.flush()) {
+    throw std::runtime_error{"cannot write " + path.string()};
+  }
+}
+
+double hub_labels::distance(index_t start, index_t end) const {
+  auto [forward_hubs, forward_distances] = forward(start);
+  auto [backward_hubs, backward_distances] = backward(end);
+  auto best = infinity;
+  // a block against a block, every pair compared without branches, then the
+  // side whose block ends on the lower hub moves on: later blocks of the
+  // other side hold only higher hubs. padding only meets padding, at an
+  // infinite distance.
+  for (std::size_t i = 0, j = 0;
+       i < forward_hubs.size() && j < backward_hubs.size();) {
+    const auto *f_hub = &forward_hubs[i], *b_hub = &backward_hubs[j];
+    const auto *f_dist = &forward_distances[i];
+    const auto *b_dist = &backward_distances[j];
+    for (std::size_t x = 0; x < block; ++x) {
+      for (std::size_t y = 0; y < block; ++y) {
+        auto sum = f_dist[x] + b_dist[y];
+        best = std::min(best, f_hub[x] == b_hub[y] ? sum : infinity);
+      }
+    }
+    auto f_last = f_hub[block - 1], b_last = b_hub[block - 1];
+    i += f_last <= b_last ? block : 0;
+    j += b_last <= f_last ? block : 0;
+  }
+  return best;
+}
+
+std::size_t hub_labels::num_entries() const {
+  std::size_t count = 0;
+  for (const auto &side : sides) {
+    auto padding = std::count(side.hubs.begin(), side.hubs.end(), no_hub);
+    count += side.hubs.size() - static_cast<std::size_t>(padding);
+  }
+  return count;
+}
+
+std::size_t hub_labels::bytes() const {
+  std::size_t total = 0;
+  for (const auto &side : sides) {
+    total += side.first.size_bytes() + side.hubs.size_bytes() +
+             side.distances.size_bytes();
+  }
+  return total;
+}
+} // namespace mapapp
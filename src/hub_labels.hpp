@@ -0,0 +1,112 @@
+#pragma once
+
+#include "contraction.hpp"
+#include "pathfind.hpp"
+#include "thread_pool.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace mapapp {
+// a whole file mapped read-only, unmapped with the last reference to it
+class mapped_file {
+public:
+  // throws std::runtime_error if the file cannot be opened or mapped
+  explicit mapped_file(const std::filesystem::path &path);
+  ~mapped_file();
+  mapped_file(const mapped_file &) = delete;
+  auto operator=(const mapped_file &) = delete;
+
+  std::span<const std::byte> bytes() const { return {data, size}; }
+
+private:
+  const std::byte *data = nullptr;
+  std::size_t size = 0;
+#ifdef _WIN32
+  void *file = nullptr, *mapping = nullptr;
+#endif
+};
+
+// hub labels (Abraham, Delling, Goldberg & Werneck): every node keeps a
+// forward label, hubs it reaches and how far they are, and a backward label,
+// hubs that reach it. the labels of `start` and `end` share a hub on a
+// shortest path between them, so a distance is the smallest sum over their
+// common hubs and no graph is searched at all.
+//
+// the labels come from a contraction hierarchy, top-down: a node's label is
+// itself and the labels of its upward neighbours, less the hubs a shorter
+// path through another hub already covers. hubs are ranks in the hierarchy.
+class hub_labels {
+public:
+  using index_t = osm_graph::index_t;
+  using hub_t = std::uint32_t;
+  static constexpr auto no_hub = static_cast<hub_t>(-1);
+  // every label is padded to a multiple of this many entries with `no_hub`
+  // at an infinite distance, so a query compares whole blocks
+  static constexpr std::size_t block = 8;
+
+  // hubs in increasing order, then the padding
+  struct label {
+    std::span<const hub_t> hubs;
+    std::span<const double> distances;
+  };
+
+  // nodes of the same height in the hierarchy, those whose higher neighbours
+  // are all done, are labelled by `num_threads` workers at once. the calling
+  // thread is one of them.
+  explicit hub_labels(const contraction_hierarchy &ch,
+                      std::size_t num_threads = thread_pool::default_size());
+  // maps a file written by `save` instead of building the labels. throws
+  // std::runtime_error if it is not one or was saved for another graph or
+  // metric.
+  hub_labels(const std::filesystem::path &path, const osm_graph &graph);
+  hub_labels(hub_labels &&) = default;
+  hub_labels &operator=(hub_labels &&) = default;
+
+  // binary, the arrays aligned so that a mapping can be read in place.
+  // throws std::runtime_error if the file cannot be written.
+  void save(const std::filesystem::path &path, const osm_graph &graph) const;
+
+  std::size_t size() const { return sides[0].first.size() - 1; }
+  label forward(index_t node) const { return get(0, node); }
+  label backward(index_t node) const { return get(1, node); }
+
+  // length of a shortest path from `start` to `end`, infinity if there is none
+  double distance(index_t start, index_t end) const;
+
+  // entries of every label, without the padding
+  std::size_t num_entries() const;
+  // size of the arrays, padding included
+  std::size_t bytes() const;
+
+private:
+  // the labels of one direction, node by node: those of node v in
+  // [first[v], first[v + 1])
+  struct side {
+    std::span<const std::uint64_t> first;
+    std::span<const hub_t> hubs;
+    std::span<const double> distances;
+  };
+  struct storage {
+    std::vector<std::uint64_t> first;
+    std::vector<hub_t> hubs;
+    std::vector<double> distances;
+  };
+
+  label get(std::size_t s, index_t node) const {
+    const auto &[first, hubs, distances] = sides[s];
+    auto begin = first[node], end = first[node + 1];
+    return {hubs.subspan(begin, end - begin),
+            distances.subspan(begin, end - begin)};
+  }
+
+  // forward, backward. they view either `owned` or `file`.
+  std::array<side, 2> sides;
+  std::array<storage, 2> owned;
+  std::shared_ptr<const mapped_file> file;
+};
+} // namespace mapapp
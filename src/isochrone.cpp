@@ -0,0 +1,85 @@
+#include "isochrone.hpp"
+
+#include <cmath>
+#include <numbers>
+#include <optional>
+
+namespace mapapp {
+std::vector<isochrone> compute_isochrones(const osm_graph &graph,
+                                          const shortest_path_tree &tree,
+                                          std::span<const double> costs,
+                                          std::size_t sectors) {
+  std::vector<isochrone> result;
+  if (tree.source == shortest_path_tree::no_parent) {
+    return result;
+  }
+
+  auto max_cost = tree.complete ? tree.budget : tree.radius();
+  std::size_t num_bands = 0;
+  while (num_bands < costs.size() && costs[num_bands] <= max_cost) {
+    ++num_bands;
+  }
+
+  // the farthest reachable point of every angular sector, per band
+  struct candidate {
+    float dist2;
+    glm::vec2 position;
+  };
+  std::vector<std::optional<candidate>> farthest(num_bands * sectors);
+  const auto center = graph.nodes[tree.source].position;
+  auto consider = [&](std::size_t band, glm::vec2 position) {
+    auto delta = position - center;
+    auto dist2 = glm::dot(delta, delta);
+    if (dist2 <= 0.0f) {
+      return;
+    }
+    auto angle = std::atan2(delta.y, delta.x) + std::numbers::pi_v<float>;
+    auto sector = std::min(
+        static_cast<std::size_t>(angle / (2 * std::numbers::pi_v<float>) *
+                                 sectors),
+        sectors - 1);
+    auto &best = farthest[band * sectors + sector];
+    if (!best.has_value() || best->dist2 < dist2) {
+      best.emplace(dist2, position);
+    }
+  };
+
+  // settled nodes come in increasing distance order, so each band is a prefix
+  for (auto node : tree.settled) {
+    auto dist = tree.distance[node];
+    if (num_bands == 0 || dist > costs[num_bands - 1]) {
+      break;
+    }
+    const auto &vertex = graph.nodes[node];
+    for (std::size_t band = 0; band < num_bands; ++band) {
+      if (dist > costs[band]) {
+        continue;
+      }
+      consider(band, vertex.position);
+      // edges leaving the band are cut where the cost runs out
+      for (const auto &[weight, next_node] : vertex.adj) {
+        if (dist + weight > costs[band] && weight > 0.0) {
+          auto t = static_cast<float>((costs[band] - dist) / weight);
+          consider(band, vertex.position +
+                             (graph.nodes[next_node].position -
+                              vertex.position) *
+                                 t);
+        }
+      }
+    }
+  }
+
+  for (std::size_t band = 0; band < num_bands; ++band) {
+    isochrone iso{costs[band], {}};
+    for (std::size_t sector = 0; sector < sectors; ++sector) {
+      if (const auto &best = farthest[band * sectors + sector]) {
+        iso.outline.push_back(best->position);
+      }
+    }
+    if (iso.outline.size() >= 3) {
+      result.push_back(std::move(iso));
+    }
+  }
+  return result;
+}
+} // namespace mapapp
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "pathfind.hpp"
+#include <glm/vec2.hpp>
+#include <span>
+#include <vector>
+
+namespace mapapp {
+struct isochrone {
+  double cost;
+  // simple polygon, star-shaped around the source of the tree
+  std::vector<glm::vec2> outline;
+};
+
+// computes one polygon per cost in `costs` (ascending) from the labels of a
+// (possibly partial) shortest path tree. costs beyond `tree.radius()` of an
+// incomplete tree are skipped since their labels are not final yet.
+std::vector<isochrone> compute_isochrones(const osm_graph &graph,
+                                          const shortest_path_tree &tree,
+                                          std::span<const double> costs,
+                                          std::size_t sectors = 120);
+} // namespace mapapp
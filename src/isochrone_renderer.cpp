@@ -0,0 +1,50 @@
+#include "isochrone_renderer.hpp"
+#include "map_renderer.hpp"
+
+namespace mapapp {
+isochrone_renderer::isochrone_renderer() {
+  vao = vertex_array::create();
+  vbo = buffer::create();
+  shd = load_map_shader();
+  loc_translation = glGetUniformLocation(shd, "translation");
+  loc_scale = glGetUniformLocation(shd, "scale");
+
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  setup_map_vertex_layout();
+}
+
+void isochrone_renderer::update(const std::vector<isochrone> &isochrones,
+                                nk_colorf inner, nk_colorf outer) {
+  std::vector<map_vertex> vertices;
+  for (std::size_t i = isochrones.size(); i-- > 0;) {
+    auto t = isochrones.size() > 1
+                 ? static_cast<float>(i) / (isochrones.size() - 1)
+                 : 0.0f;
+    auto mix = [&](float a, float b) {
+      return static_cast<std::uint8_t>((a + (b - a) * t) * 255.0f);
+    };
+    glm::u8vec4 color{mix(inner.r, outer.r), mix(inner.g, outer.g),
+                      mix(inner.b, outer.b), mix(inner.a, outer.a)};
+    triangulate_polygon(vertices, isochrones[i].outline, color);
+  }
+
+  count = static_cast<int>(vertices.size());
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertices[0]),
+               vertices.data(), GL_DYNAMIC_DRAW);
+}
+
+void isochrone_renderer::reset() { count = 0; }
+
+void isochrone_renderer::render(const camera::transform &transform) {
+  if (count == 0) {
+    return;
+  }
+  glUseProgram(shd);
+  glUniform2fv(loc_translation, 1, &transform.translation[0]);
+  glUniform2fv(loc_scale, 1, &transform.scale[0]);
+  glBindVertexArray(vao);
+  glDrawArrays(GL_TRIANGLES, 0, count);
+}
+} // namespace mapapp
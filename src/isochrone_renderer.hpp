@@ -0,0 +1,28 @@
+#pragma once
+
+#include "camera.hpp"
+#include "gl.hpp"
+#include "isochrone.hpp"
+#include "nk.h"
+#include <glad/gl.h>
+#include <vector>
+
+namespace mapapp {
+// draws isochrone polygons through the map's earcut pipeline, outermost first
+// so that the inner bands stack on top
+struct isochrone_renderer {
+  vertex_array vao;
+  buffer vbo;
+  shader shd;
+  GLint loc_translation, loc_scale;
+  int count = 0;
+
+  isochrone_renderer();
+
+  // colors are interpolated from `inner` (lowest cost) to `outer`
+  void update(const std::vector<isochrone> &isochrones, nk_colorf inner,
+              nk_colorf outer);
+  void reset();
+  void render(const camera::transform &transform);
+};
+} // namespace mapapp
@@ -0,0 +1,161 @@
+#include "k_shortest.hpp"
+
+#include <algorithm>
+#include <set>
+
+namespace mapapp {
+namespace {
+using index_t = osm_graph::index_t;
+constexpr auto no_node = shortest_path_tree::no_parent;
+constexpr auto infinity = shortest_path_tree::unreached;
+
+struct ksp_path {
+  std::vector<index_t> nodes;
+  // prefix[i] is the distance from the start to nodes[i]
+  std::vector<double> prefix;
+  // spur nodes before this index were already tried by the parent path
+  std::size_t deviation;
+
+  double distance() const { return prefix.back(); }
+};
+
+// the lightest arc from `u` to `v`, the one every shortest path takes
+double arc_weight(const osm_graph &graph, index_t u, index_t v) {
+  double weight = infinity;
+  for (const auto &[w, head] : graph.nodes[u].adj) {
+    if (head == v) {
+      weight = std::min(weight, w);
+    }
+  }
+  return weight;
+}
+
+} // namespace
+
+k_shortest_result k_shortest_paths(std::stop_token token,
+                                   const osm_graph &graph, id_t start,
+                                   id_t end, std::size_t k,
+                                   k_shortest_workspace &ws,
+                                   const search_limits &limits) {
+  k_shortest_result result;
+  if (k == 0 || !graph.may_reach(start, end)) {
+    return result;
+  }
+  grow_shortest_path_tree(token, graph, end,
+                          {.reverse = true, .limits = limits}, ws.reverse);
+  if (!ws.reverse.complete) {
+    result.stopped = true;
+    return result;
+  }
+  if (!ws.reverse.reached(start)) {
+    return result;
+  }
+
+  if (ws.blocked.size() != graph.nodes.size()) {
+    ws.blocked.assign(graph.nodes.size(), 0);
+    ws.generation = 0;
+  }
+
+  // the first path is read off the reverse tree. its prefix lengths are
+  // summed arc by arc like those of the spur paths, so that distances of
+  // equal paths compare equal.
+  std::vector<ksp_path> accepted(1);
+  auto &first = accepted[0];
+  first.deviation = 0;
+  first.nodes.push_back(start);
+  first.prefix.push_back(0.0);
+  for (auto u = ws.reverse.parent[start]; u != no_node;
+       u = ws.reverse.parent[u]) {
+    first.prefix.push_back(first.prefix.back() +
+                           arc_weight(graph, first.nodes.back(), u));
+    first.nodes.push_back(u);
+  }
+
+  auto by_distance = [](const ksp_path &a, const ksp_path &b) {
+    return a.distance() < b.distance() ||
+           (a.distance() == b.distance() && a.nodes < b.nodes);
+  };
+  std::set<ksp_path, decltype(by_distance)> candidates{by_distance};
+  // a spur search skips the nodes of its root path and the arcs from the spur
+  // node that paths sharing the root already took
+  const auto &to_end = ws.reverse.distance;
+  std::vector<index_t> blocked_heads;
+  index_t spur = no_node;
+  auto allowed = [&](index_t tail, std::size_t a) {
+    auto head = graph.nodes[tail].adj[a].second;
+    return ws.blocked[head] != ws.generation && to_end[head] != infinity &&
+           (tail != spur || std::find(blocked_heads.begin(),
+                                      blocked_heads.end(),
+                                      head) == blocked_heads.end());
+  };
+
+  while (accepted.size() < k) {
+    if (token.stop_requested()) {
+      result.stopped = true;
+      break;
+    }
+    const auto &last = accepted.back();
+    for (auto i = last.deviation; i + 1 < last.nodes.size(); ++i) {
+      // only candidates that can still make it into the first k matter
+      auto limit = infinity;
+      auto needed = k - accepted.size();
+      if (candidates.size() >= needed) {
+        limit = std::next(candidates.begin(), needed - 1)->distance();
+      }
+      spur = last.nodes[i];
+      auto root_length = last.prefix[i];
+      if (root_length + ws.reverse.distance[spur] >= limit) {
+        continue;
+      }
+
+      ++ws.generation;
+      for (std::size_t j = 0; j < i; ++j) {
+        ws.blocked[last.nodes[j]] = ws.generation;
+      }
+      blocked_heads.clear();
+      for (const auto &path : accepted) {
+        if (path.nodes.size() > i + 1 &&
+            std::equal(path.nodes.begin(), path.nodes.begin() + i + 1,
+                       last.nodes.begin())) {
+          blocked_heads.push_back(path.nodes[i + 1]);
+        }
+      }
+
+      auto spur_path = guided_search(token, graph, spur, end, limits,
+                                     to_end, allowed, limit - root_length);
+      if (spur_path.stopped) {
+        result.stopped = true;
+        break;
+      }
+      if (!spur_path) {
+        continue;
+      }
+      ksp_path candidate{{last.nodes.begin(), last.nodes.begin() + i + 1},
+                         {last.prefix.begin(), last.prefix.begin() + i + 1},
+                         i};
+      // the spur path runs from `end` back to the spur node
+      for (auto it = std::next(spur_path.path.rbegin());
+           it != spur_path.path.rend(); ++it) {
+        candidate.prefix.push_back(candidate.prefix.back() +
+                                   arc_weight(graph, candidate.nodes.back(),
+                                              *it));
+        candidate.nodes.push_back(*it);
+      }
+      candidates.insert(std::move(candidate));
+    }
+
+    if (result.stopped || candidates.empty()) {
+      break;
+    }
+    accepted.push_back(
+        std::move(candidates.extract(candidates.begin()).value()));
+  }
+
+  for (const auto &path : accepted) {
+    auto &found = result.paths.emplace_back();
+    found.path.assign(path.nodes.rbegin(), path.nodes.rend());
+    found.distance = path.distance();
+  }
+  return result;
+}
+} // namespace mapapp
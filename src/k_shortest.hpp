@@ -0,0 +1,36 @@
+#pragma once
+
+#include "pathfind.hpp"
+#include <cstdint>
+#include <stop_token>
+#include <vector>
+
+namespace mapapp {
+// search state shared by all spur searches of a query (and between queries).
+// the nodes a spur search may not enter are marked with the current
+// `generation`, so they are released by bumping it instead of clearing.
+struct k_shortest_workspace {
+  // distances to the target, exact lower bounds for every spur search
+  shortest_path_tree reverse;
+  std::vector<std::uint32_t> blocked;
+  std::uint32_t generation = 0;
+};
+
+struct k_shortest_result {
+  // ordered by distance
+  std::vector<pathfind_result> paths;
+  // cancelled or out of limits before k paths were found, more may exist
+  bool stopped = false;
+};
+
+// Yen's algorithm for loopless paths, ordered by distance. spur searches are
+// `guided_search` on the reverse tree, only start at or after the deviation
+// node of the path they branch from, and are pruned as soon as they cannot
+// beat the k-th candidate. like other results, paths run from `end` to
+// `start`. `limits` apply to the reverse tree and to each spur search.
+k_shortest_result k_shortest_paths(std::stop_token token,
+                                   const osm_graph &graph, id_t start,
+                                   id_t end, std::size_t k,
+                                   k_shortest_workspace &workspace,
+                                   const search_limits &limits = {});
+} // namespace mapapp
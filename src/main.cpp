@@ -1,22 +1,32 @@
+#include "alternatives.hpp"
+#include "bench.hpp"
 #include "camera.hpp"
+#include "compressed_graph.hpp"
 #include "gpu_timer.hpp"
 #include "graphics_context.hpp"
+#include "isochrone.hpp"
+#include "frontier_renderer.hpp"
+#include "frontier_stream.hpp"
+#include "isochrone_renderer.hpp"
 #include "map_loader.hpp"
 #include "map_renderer.hpp"
+#include "multilevel_dijkstra.hpp"
 #include "nk.h"
 #include "path_renderer.hpp"
 #include "pathfind.hpp"
 #include "pin_renderer.hpp"
+#include "routing_profile.hpp"
+#include "thread_pool.hpp"
 #include <GLFW/glfw3.h>
 #include <chrono>
 #include <cmath>
 #include <cstdio>
 #include <fmt/ranges.h>
-#include <future>
 #include <glad/gl.h>
 #include <glm/ext/vector_double2.hpp>
 #include <glm/ext/vector_uint4_sized.hpp>
 #include <mapbox/earcut.hpp>
+#include <memory>
 #include <mutex>
 #include <nanoflann.hpp>
 #include <optional>
@@ -25,50 +35,264 @@
 #include <thread>
 #include <utility>
 
+// the graph of a routing profile and the compressed graph searches run on
+struct profile_graph {
+  mapapp::osm_graph graph;
+  mapapp::compressed_graph routing{graph};
+
+  profile_graph(const mapapp::map_loader &map,
+                const mapapp::routing_profile *profile)
+      : graph{map, profile} {}
+
+  // the multi-level overlay of `routing`, built by the first query that needs
+  // it on whichever worker runs that query
+  const mapapp::multilevel_overlay &overlay() {
+    std::call_once(overlay_built, [this] {
+      crp = std::make_unique<mapapp::multilevel_overlay>(routing.graph);
+    });
+    return *crp;
+  }
+
+private:
+  std::once_flag overlay_built;
+  std::unique_ptr<mapapp::multilevel_overlay> crp;
+};
+
 struct algo_state {
   const char *short_name, *long_name;
   nk_bool enabled = true;
   nk_colorf path_color;
   using time_pt = std::chrono::time_point<std::chrono::high_resolution_clock>;
+  // submission time, set while a query is queued, running or finished
   std::optional<time_pt> begin;
-  std::jthread thread;
+  std::stop_source stop;
   std::mutex result_mtx;
+  // set once a worker picks the query up
+  std::optional<time_pt> started;
   std::optional<mapapp::pathfind_result> result;
   std::optional<int> path_renderer_index;
+  // nodes settled by the current run, only when streaming was asked for
+  std::shared_ptr<mapapp::frontier_stream> frontier;
+  // set while a lockstep run is in progress, only touched by the render loop
+  std::optional<mapapp::search_task> task;
+  const mapapp::compressed_graph *routing = nullptr;
 
-  algo_state(const char *short_name, const char *long_name, nk_colorf color)
-      : short_name{short_name}, long_name{long_name}, path_color{color} {}
+  algo_state(const char *short_name, const char *long_name, nk_colorf color,
+             bool enabled = true)
+      : short_name{short_name}, long_name{long_name}, enabled{enabled},
+        path_color{color} {}
 
   void reset() {
-    thread = {}; // stop currently running thread
+    cancel();
     begin = std::nullopt;
-    result = std::nullopt; // locking mutex not necessary as the thread is
-                           // already stopped
     path_renderer_index.reset();
+    frontier.reset();
   }
 
   static auto now() { return std::chrono::high_resolution_clock::now(); }
 
   auto use_result(auto fn) {
     std::scoped_lock lock{result_mtx};
-    return fn(result,
-              std::chrono::duration<double>(
-                  (result.has_value() ? result->finish_time : now()) - *begin));
+    return fn(result, started);
+  }
+
+  // `start` and `end` are junctions, given as nodes of the full graph. the
+  // search runs on the compressed graph, its path is unpacked. `index` past
+  // the end of `algorithms` runs a query on the overlay of `active`.
+  void run(mapapp::thread_pool &pool, std::size_t index, profile_graph &active,
+           mapapp::osm_graph::index_t start, mapapp::osm_graph::index_t end,
+           const mapapp::search_limits &limits, bool stream_frontier,
+           bool lockstep) {
+    cancel();
+    const auto &routing = active.routing;
+    this->routing = &routing;
+    start = routing.junction[start];
+    end = routing.junction[end];
+    auto submitted = now();
+    begin.emplace(submitted);
+    // every run gets its own stream, a cancelled run may still be publishing
+    // into the previous one
+    frontier = stream_frontier ? std::make_shared<mapapp::frontier_stream>()
+                               : nullptr;
+    // the overlay has no stepper, it always runs on a worker
+    if (lockstep && index < mapapp::steppers.size()) {
+      // advanced by `step` from the render loop instead of a worker
+      task.emplace(
+          mapapp::steppers[index]({}, routing.graph, start, end, limits));
+      std::scoped_lock lock{result_mtx};
+      started.emplace(submitted);
+      return;
+    }
+    stop = pool.submit([this, &active, &routing, index, start, end, limits,
+                        submitted,
+                        frontier = frontier](std::stop_token token) {
+      std::optional<mapapp::frontier_stream::scope> frontier_scope;
+      if (frontier) {
+        frontier_scope.emplace(*frontier);
+      }
+      {
+        std::scoped_lock lock{result_mtx};
+        if (token.stop_requested()) {
+          return;
+        }
+        started.emplace(now());
+      }
+      auto result =
+          index < mapapp::algorithms.size()
+              ? mapapp::algorithms[index](token, routing.graph, start, end,
+                                          limits)
+              : active.overlay().query(token, start, end, limits);
+      routing.unpack(result);
+      result.finish_time = now();
+      std::scoped_lock lock{result_mtx};
+      // a cancelled query must not overwrite the state of its successor
+      if (token.stop_requested()) {
+        return;
+      }
+      result.submit_time = submitted;
+      result.start_time = *started;
+      this->result.emplace(std::move(result));
+    });
+  }
+
+  // runs a lockstep search for up to `k` more expanded nodes on this thread
+  void step(std::size_t k) {
+    if (!task) {
+      return;
+    }
+    {
+      std::optional<mapapp::frontier_stream::scope> frontier_scope;
+      if (frontier) {
+        frontier_scope.emplace(*frontier);
+      }
+      task->set_step(k);
+      auto done = task->advance();
+      if (frontier) {
+        frontier->flush();
+      }
+      if (!done) {
+        return;
+      }
+    }
+    auto result = std::move(task->result());
+    task.reset();
+    routing->unpack(result);
+    result.finish_time = now();
+    std::scoped_lock lock{result_mtx};
+    result.submit_time = *begin;
+    result.start_time = *started;
+    this->result.emplace(std::move(result));
+  }
+
+private:
+  void cancel() {
+    stop.request_stop();
+    task.reset();
+    std::scoped_lock lock{result_mtx};
+    started.reset();
+    result.reset();
+  }
+};
+
+struct alternatives_state {
+  static constexpr std::array<nk_colorf, 3> colors{
+      nk_colorf{0.1, 0.4, 0.9, 0.6},
+      nk_colorf{0.9, 0.5, 0.1, 0.6},
+      nk_colorf{0.6, 0.1, 0.6, 0.6},
+  };
+
+  nk_bool enabled = false;
+  std::stop_source stop;
+  // held by the running search, a cancelled one may still be unwinding when
+  // the next one is picked up
+  std::mutex workspace_mtx;
+  mapapp::alternative_workspace workspace;
+  std::mutex result_mtx;
+  std::optional<std::vector<mapapp::pathfind_result>> routes;
+  std::vector<std::size_t> path_renderer_indices;
+
+  void reset() {
+    stop.request_stop();
+    std::scoped_lock lock{result_mtx};
+    routes.reset();
+    path_renderer_indices.clear();
   }
 
-  void run(int index, const mapapp::osm_graph &graph,
+  void run(mapapp::thread_pool &pool, const mapapp::osm_graph &graph,
            mapapp::osm_graph::index_t start, mapapp::osm_graph::index_t end) {
-    std::promise<time_pt> begin_p;
-    thread = std::jthread{[&](std::stop_token token, int index) {
-                            begin_p.set_value(now());
-                            auto result = mapapp::algorithms[index](
-                                token, graph, start, end);
-                            result.finish_time = now();
-                            std::scoped_lock lock{result_mtx};
-                            this->result.emplace(std::move(result));
-                          },
-                          index};
-    begin.emplace(begin_p.get_future().get());
+    reset();
+    stop = pool.submit([this, &graph, start, end](std::stop_token token) {
+      std::scoped_lock workspace_lock{workspace_mtx};
+      mapapp::alternative_options options;
+      options.max_alternatives = colors.size() - 1;
+      auto routes = mapapp::alternative_routes(token, graph, start, end,
+                                               workspace, options);
+      std::scoped_lock lock{result_mtx};
+      if (!token.stop_requested()) {
+        this->routes.emplace(std::move(routes));
+      }
+    });
+  }
+};
+
+struct isochrone_state {
+  float budget = 3000.0f;
+  int num_bands = 4;
+  nk_colorf inner_color{0.2, 0.8, 0.3, 0.35}, outer_color{0.9, 0.3, 0.2, 0.2};
+  std::stop_source stop;
+  // held by the running search, see `alternatives_state`
+  std::mutex tree_mtx;
+  mapapp::shortest_path_tree tree;
+  std::mutex result_mtx;
+  std::vector<mapapp::isochrone> isochrones;
+  std::size_t settled = 0;
+  double radius = 0.0;
+  bool running = false, complete = false, updated = false;
+
+  void reset() {
+    stop.request_stop();
+    running = false;
+    std::scoped_lock lock{result_mtx};
+    isochrones.clear();
+    settled = 0;
+    radius = 0.0;
+    complete = false;
+    updated = true;
+  }
+
+  void run(mapapp::thread_pool &pool, const mapapp::osm_graph &graph,
+           mapapp::osm_graph::index_t source) {
+    reset();
+    running = true;
+    std::vector<double> costs;
+    for (int i = 1; i <= num_bands; ++i) {
+      costs.push_back(static_cast<double>(budget) * i / num_bands);
+    }
+    stop = pool.submit([this, &graph, source, costs = std::move(costs)](
+                           std::stop_token token) {
+      using namespace std::chrono_literals;
+      std::scoped_lock tree_lock{tree_mtx};
+      auto last_update = algo_state::now();
+      auto publish = [&](const mapapp::shortest_path_tree &tree) {
+        // partial trees are streamed at a rate the UI can keep up with
+        if (!tree.complete && algo_state::now() - last_update < 50ms) {
+          return;
+        }
+        last_update = algo_state::now();
+        auto isochrones = mapapp::compute_isochrones(graph, tree, costs);
+        std::scoped_lock lock{result_mtx};
+        if (token.stop_requested()) {
+          return;
+        }
+        this->isochrones = std::move(isochrones);
+        settled = tree.settled.size();
+        radius = tree.radius();
+        complete = tree.complete;
+        updated = true;
+      };
+      mapapp::ucs_one_to_all(token, graph, source, costs.back(), tree,
+                             publish);
+    });
   }
 };
 
@@ -101,9 +325,30 @@ auto fmt_dist(double meters) {
   }
 }
 
+auto fmt_duration(double seconds) {
+  auto total = static_cast<long long>(std::round(seconds));
+  if (total >= 3600) {
+    return fmt::format("{} giờ {} phút", total / 3600, total % 3600 / 60);
+  } else if (total >= 60) {
+    return fmt::format("{} phút {} giây", total / 60, total % 60);
+  } else {
+    return fmt::format("{} giây", total);
+  }
+}
+
+// a cost of the active profile: metres, or seconds for a travel time
+auto fmt_cost(double cost, bool travel_time) {
+  return travel_time ? fmt_duration(cost) : fmt_dist(cost);
+}
+
 int main(int argc, char *argv[]) {
-  if (argc != 2) {
-    fmt::println("Cách sử dụng: {} [đường dẫn tới file .pbf]", argv[0]);
+  if (argc < 2) {
+    fmt::println("Cách sử dụng: {} [đường dẫn tới file .pbf] [--queries N "
+                 "[ms] | --phast N | --sssp N | --arena N | --interleave N | "
+                 "--memory N [ms] | --compressed N | --cch N | --partition N | "
+                 "--crp N | --arc-flags N | --hub-labels N | --transit-nodes N "
+                 "| --profiles N | --ksp N]",
+                 argv[0]);
     std::exit(1);
   }
 
@@ -112,11 +357,38 @@ int main(int argc, char *argv[]) {
   mapapp::map_loader loader;
   loader.load(argv[1]);
   const auto normalize_offset = loader.normalize_node_positions();
-  mapapp::osm_graph graph{loader};
+  if (argc > 2) {
+    mapapp::osm_graph graph{loader};
+    return mapapp::run_batch(loader, graph, {argv + 2, argv + argc});
+  }
+  // by length, then one per entry of `profiles`. each is built the first time
+  // it is picked and kept, so switching back is instant.
+  std::array<std::unique_ptr<profile_graph>, 1 + mapapp::profiles.size()>
+      profile_graphs;
+  int profile = 0;
 
   mapapp::graphics_context gc;
   mapapp::map_renderer map_renderer{loader};
   mapapp::path_renderer path_renderer;
+  mapapp::isochrone_renderer isochrone_renderer;
+  // settled junctions of each algorithm and of the overlay query, streamed
+  // while it runs
+  std::array<mapapp::frontier_renderer, mapapp::algorithms.size() + 1>
+      frontier_renderers;
+  nk_bool show_frontier = false;
+  // run the searches on the render loop, all advanced by the same number of
+  // expanded nodes every frame
+  nk_bool lockstep = false;
+  int lockstep_step = 256;
+  // applies to every algorithm, 0 for none
+  int memory_limit_kib = 0;
+  auto query_limits = [&] {
+    mapapp::search_limits limits;
+    if (memory_limit_kib > 0) {
+      limits.max_memory = std::size_t(memory_limit_kib) * 1024;
+    }
+    return limits;
+  };
   mapapp::pin_renderer pin_renderer;
   // renders the path from to cursor position to the nearest node
   mapapp::path_renderer to_node_path_renderer;
@@ -134,36 +406,27 @@ int main(int argc, char *argv[]) {
       algo_state{
           "UCS", "UCS (Tìm kiếm với chi phí cực tiểu)", {0.8, 0.4, 0.2, 0.5}},
       algo_state{"A*", "A*", {0.6, 0.2, 0.8, 0.5}},
+      // off by default, both can run for a long time on a small memory limit
+      algo_state{"IDA*", "IDA* (A* sâu dần)", {0.2, 0.8, 0.7, 0.5}, false},
+      algo_state{
+          "SMA*", "SMA* (A* giới hạn bộ nhớ)", {0.8, 0.2, 0.4, 0.5}, false},
+      // off by default, the first query of each profile builds the overlay
+      algo_state{"CRP", "CRP (Dijkstra đa mức)", {0.3, 0.5, 0.3, 0.5}, false},
   };
 
   std::optional<mapapp::osm_graph::index_t> start, end;
   glm::vec2 start_pos, end_pos;
-
-  for (std::size_t i = 0; i < 0; ++i) {
-    static std::mt19937 rng;
-    using id_t = mapapp::osm_graph::index_t;
-    id_t start, end;
-    do {
-      start =
-          std::uniform_int_distribution<int>{0, static_cast<int>(graph.nodes.size() - 1)}(rng);
-      end = std::uniform_int_distribution<int>{0, static_cast<int>(graph.nodes.size() - 1)}(rng);
-    } while (start == end);
-
-    for (std::size_t k = 0; k < algos.size(); ++k) {
-      auto time_start = algo_state::now();
-      auto result = mapapp::algorithms[k](std::stop_token{}, graph, start, end);
-      result.finish_time = algo_state::now();
-      fmt::println(
-          "{} {} {} {} {} {} {}", k, start, end, result.distance,
-          std::chrono::nanoseconds{result.finish_time - time_start}.count(),
-          result.mem_stat.max_allocated, result.mem_stat.total_allocated);
-    }
-  }
+  isochrone_state isochrone;
+  alternatives_state alternatives;
+  // declared after the states above so that it is shut down, and the tasks
+  // referring to them are finished, before they are destroyed
+  mapapp::thread_pool query_pool;
 
   enum class PickPointState {
     Pending,
     PickStart,
     PickEnd,
+    PickIsochroneSource,
   };
 
   PickPointState state = PickPointState::Pending;
@@ -174,6 +437,10 @@ int main(int argc, char *argv[]) {
     for (auto &algo : algos) {
       algo.reset();
     }
+    for (auto &renderer : frontier_renderers) {
+      renderer.reset();
+    }
+    alternatives.reset();
   };
 
   std::chrono::duration<double> last_cpu_time{0.0};
@@ -182,6 +449,15 @@ int main(int argc, char *argv[]) {
   while (gc) {
     auto cpu_start = std::chrono::high_resolution_clock::now();
 
+    auto &active = profile_graphs[profile];
+    if (!active) {
+      active = std::make_unique<profile_graph>(
+          loader, profile == 0 ? nullptr : &mapapp::profiles[profile - 1]);
+    }
+    const auto &graph = active->graph;
+    const auto &routing = active->routing;
+    const bool travel_time = profile != 0;
+
     gpu_timer.begin();
     auto viewport = gc.begin();
     auto transform = cam.update(viewport);
@@ -201,11 +477,57 @@ int main(int argc, char *argv[]) {
           path_renderer.add_path(std::move(positions), algo.path_color);
     }
 
+    for (auto &algo : algos) {
+      algo.step(lockstep_step);
+    }
+
+    std::vector<std::size_t> settled_nodes;
+    std::vector<glm::vec2> settled_positions;
+    for (std::size_t i = 0; i < algos.size(); ++i) {
+      if (!algos[i].frontier) {
+        continue;
+      }
+      settled_nodes.clear();
+      algos[i].frontier->drain(settled_nodes);
+      settled_positions.clear();
+      for (auto node_index : settled_nodes) {
+        settled_positions.push_back(
+            routing.graph.nodes[node_index].position);
+      }
+      frontier_renderers[i].append(settled_positions);
+    }
+
+    {
+      std::scoped_lock lock{alternatives.result_mtx};
+      if (alternatives.path_renderer_indices.empty() &&
+          alternatives.routes.has_value()) {
+        const auto &routes = *alternatives.routes;
+        for (std::size_t i = 0; i < routes.size(); ++i) {
+          std::vector<glm::vec2> positions;
+          for (auto node_index : routes[i].path) {
+            positions.push_back(graph.nodes[node_index].position);
+          }
+          alternatives.path_renderer_indices.push_back(path_renderer.add_path(
+              std::move(positions), alternatives_state::colors[i]));
+        }
+      }
+    }
+
+    {
+      std::scoped_lock lock{isochrone.result_mtx};
+      if (isochrone.updated) {
+        isochrone_renderer.update(isochrone.isochrones, isochrone.inner_color,
+                                  isochrone.outer_color);
+        isochrone.updated = false;
+      }
+    }
+
     auto mouse_pos = gc.cursor_pos();
     mouse_pos = mouse_pos / glm::dvec2{viewport} * 2.0 - 1.0;
     mouse_pos.y *= -1;
     auto pos = glm::dvec2{transform.unmap(mouse_pos)};
-    auto nearest_node = graph.nn_query(pos);
+    // junctions only, every query can then run on the compressed graph
+    auto nearest_node = routing.original[routing.graph.nn_query(pos)];
 
     auto ctx = gc.ui();
     if (nk_begin(ctx, "Project AI", nk_rect(50, 50, 450, 400),
@@ -217,13 +539,29 @@ int main(int argc, char *argv[]) {
         state = PickPointState::PickStart;
       }
 
+      std::array<const char *, profile_graphs.size()> profile_names{
+          "Quãng đường ngắn nhất"};
+      for (std::size_t i = 0; i < mapapp::profiles.size(); ++i) {
+        profile_names[i + 1] = mapapp::profiles[i].name;
+      }
+      auto picked = nk_combo(ctx, profile_names.data(), profile_names.size(),
+                             profile, 20, nk_vec2(200, 200));
+      if (picked != profile) {
+        // the nodes of the results belong to the old profile's graph
+        reset_state();
+        isochrone.reset();
+        profile = picked;
+      }
+
       if (state == PickPointState::PickStart) {
         nk_label(ctx, "Chọn điểm đầu", NK_TEXT_CENTERED);
       } else if (state == PickPointState::PickEnd) {
         nk_label(ctx, "Chọn điểm cuối", NK_TEXT_CENTERED);
+      } else if (state == PickPointState::PickIsochroneSource) {
+        nk_label(ctx, "Chọn tâm vùng đẳng thời", NK_TEXT_CENTERED);
       }
 
-      for (int i = 0; i < algos.size(); ++i) {
+      for (std::size_t i = 0; i < algos.size(); ++i) {
         auto &algo = algos[i];
         bool enabled = algo.enabled;
         nk_layout_row_template_begin(ctx, 20);
@@ -236,7 +574,8 @@ int main(int argc, char *argv[]) {
         if (nk_checkbox_label(ctx, algo.long_name, &algo.enabled)) {
           if (algo.enabled && !algo.begin && start.has_value() &&
               end.has_value()) {
-            algo.run(i, graph, *start, *end);
+            algo.run(query_pool, i, *active, *start, *end, query_limits(),
+                     show_frontier, lockstep);
           }
         }
         if (enabled) {
@@ -259,6 +598,23 @@ int main(int argc, char *argv[]) {
       }
 
       nk_layout_row_dynamic(ctx, 20, 1);
+      // only affects runs started afterwards, searches pay nothing without it
+      nk_checkbox_label(ctx, "Hiển thị quá trình tìm kiếm", &show_frontier);
+      nk_checkbox_label(ctx, "Chạy lần lượt trên luồng giao diện", &lockstep);
+      if (lockstep) {
+        // takes effect from the next frame, also for searches in progress
+        lockstep_step = nk_propertyi(ctx, "Số đỉnh mỗi khung hình:", 1,
+                                     lockstep_step, 1 << 20, 16, 4.0f);
+      }
+      memory_limit_kib = nk_propertyi(ctx, "Giới hạn bộ nhớ (KiB, 0 = không):",
+                                      0, memory_limit_kib, 1 << 20, 64, 16.0f);
+      if (nk_checkbox_label(ctx, "Các tuyến đường thay thế",
+                            &alternatives.enabled)) {
+        if (alternatives.enabled && start.has_value() && end.has_value()) {
+          alternatives.run(query_pool, graph, *start, *end);
+        }
+      }
+
       if (std::any_of(algos.begin(), algos.end(), [](const auto &algo) {
             return algo.begin && algo.enabled;
           })) {
@@ -277,29 +633,81 @@ int main(int argc, char *argv[]) {
           continue;
         }
 
-        auto msg = algo.use_result([&](const auto &result, auto cpu_time) {
-          auto time_str = fmt_time(cpu_time);
+        auto msg = algo.use_result([&](const auto &result,
+                                       const auto &started) {
           if (result.has_value()) {
-            if (std::isnan(result->distance)) {
-              return fmt::format(
-                  "{}: không tìm thấy đường (tổng thời gian {}, bộ nhớ {}/{})",
-                  algo.short_name, fmt_time(cpu_time),
-                  fmt_bytes(result->mem_stat.max_allocated),
+            auto stats = fmt::format("chờ {}, thực hiện {}",
+                                     fmt_time(result->queue_delay()),
+                                     fmt_time(result->execution_time()));
+            if constexpr (mapapp::memory_statistics::enabled) {
+              stats += fmt::format(
+                  ", bộ nhớ {}/{}", fmt_bytes(result->mem_stat.max_allocated),
                   fmt_bytes(result->mem_stat.total_allocated));
             }
-            return fmt::format(
-                "{}: khoảng cách {} (tổng thời gian {}, bộ nhớ {}/{})",
-                algo.short_name, fmt_dist(result->distance), fmt_time(cpu_time),
-                fmt_bytes(result->mem_stat.max_allocated),
-                fmt_bytes(result->mem_stat.total_allocated));
+            if (std::isnan(result->distance)) {
+              return fmt::format("{}: không tìm thấy đường ({})",
+                                 algo.short_name, stats);
+            }
+            return fmt::format("{}: {} {} ({})", algo.short_name,
+                               travel_time ? "thời gian" : "khoảng cách",
+                               fmt_cost(result->distance, travel_time), stats);
+          } else if (started.has_value()) {
+            return fmt::format("{}: đang thực hiện ({})", algo.short_name,
+                               fmt_time(algo_state::now() - *started));
           } else {
-            return fmt::format("{}: đang thực hiện (tổng thời gian {})",
-                               algo.short_name, time_str);
+            return fmt::format("{}: đang chờ ({})", algo.short_name,
+                               fmt_time(algo_state::now() - *algo.begin));
           }
         });
         nk_label(ctx, msg.data(), NK_TEXT_LEFT);
       }
 
+      if (alternatives.enabled && end.has_value()) {
+        std::scoped_lock lock{alternatives.result_mtx};
+        if (!alternatives.routes.has_value()) {
+          nk_label(ctx, "Tuyến thay thế: đang thực hiện", NK_TEXT_LEFT);
+        } else if (alternatives.routes->empty()) {
+          nk_label(ctx, "Tuyến thay thế: không tìm thấy đường", NK_TEXT_LEFT);
+        }
+        for (std::size_t i = 0; alternatives.routes.has_value() &&
+                                i < alternatives.routes->size();
+             ++i) {
+          auto msg = fmt::format(
+              "{}: {} {}",
+              i == 0 ? "Tuyến ngắn nhất" : fmt::format("Tuyến thay thế {}", i),
+              travel_time ? "thời gian" : "khoảng cách",
+              fmt_cost((*alternatives.routes)[i].distance, travel_time));
+          nk_label(ctx, msg.c_str(), NK_TEXT_LEFT);
+        }
+      }
+
+      if (nk_tree_push(ctx, NK_TREE_TAB, "Vùng đẳng thời", NK_MINIMIZED)) {
+        nk_layout_row_dynamic(ctx, 20, 1);
+        isochrone.budget = nk_propertyf(
+            ctx, travel_time ? "Chi phí tối đa (s):" : "Chi phí tối đa (m):",
+            100.0f, isochrone.budget, 100000.0f, 100.0f, 10.0f);
+        isochrone.num_bands =
+            nk_propertyi(ctx, "Số vùng:", 1, isochrone.num_bands, 8, 1, 0.1f);
+        nk_layout_row_dynamic(ctx, 20, 2);
+        if (nk_button_label(ctx, "Chọn tâm")) {
+          state = PickPointState::PickIsochroneSource;
+        }
+        if (nk_button_label(ctx, "Xóa")) {
+          isochrone.reset();
+        }
+        nk_layout_row_dynamic(ctx, 20, 1);
+        if (isochrone.running) {
+          std::scoped_lock lock{isochrone.result_mtx};
+          auto msg = fmt::format("{}: {} đỉnh, bán kính {}",
+                                 isochrone.complete ? "hoàn tất"
+                                                    : "đang thực hiện",
+                                 isochrone.settled,
+                                 fmt_cost(isochrone.radius, travel_time));
+          nk_label(ctx, msg.c_str(), NK_TEXT_LEFT);
+        }
+        nk_tree_pop(ctx);
+      }
+
       if (nk_tree_push(ctx, NK_TREE_TAB, "Thông tin gỡ lỗi", NK_MINIMIZED)) {
         nk_layout_row_dynamic(ctx, 20, 1);
         auto msg = fmt::format("start_node: {} ({})",
@@ -312,10 +720,31 @@ int main(int argc, char *argv[]) {
         msg = fmt::format("nearest_node: {} ({})", graph.nodes[nearest_node].id,
                           nearest_node);
         nk_label(ctx, msg.c_str(), NK_TEXT_LEFT);
+        msg = fmt::format("nodes: {}, junctions: {}, components: {}, "
+                          "snap_points: {}, restrictions: {}",
+                          graph.nodes.size(), routing.graph.nodes.size(),
+                          routing.graph.num_components,
+                          routing.graph.snap.indices.size(),
+                          loader.restrictions.size());
+        nk_label(ctx, msg.c_str(), NK_TEXT_LEFT);
         msg = fmt::format("last_cpu_time: {}", fmt_time(last_cpu_time));
         nk_label(ctx, msg.c_str(), NK_TEXT_LEFT);
         msg = fmt::format("last_gpu_time: {}", fmt_time(gpu_timer.last_time));
         nk_label(ctx, msg.c_str(), NK_TEXT_LEFT);
+        if constexpr (mapapp::search_counters::enabled) {
+          for (auto &algo : algos) {
+            std::scoped_lock lock{algo.result_mtx};
+            if (!algo.result.has_value()) {
+              continue;
+            }
+            const auto &c = algo.result->counters;
+            msg = fmt::format("{}: settled {}, relaxed {}, push/pop {}/{}, "
+                              "decrease_key {}, max_frontier {}",
+                              algo.short_name, c.settled, c.relaxed, c.pushes,
+                              c.pops, c.decrease_keys, c.max_frontier);
+            nk_label(ctx, msg.c_str(), NK_TEXT_LEFT);
+          }
+        }
         nk_tree_pop(ctx);
       }
     }
@@ -339,7 +768,10 @@ int main(int argc, char *argv[]) {
       if (state != PickPointState::Pending) {
         const auto &lmb = input.mouse.buttons[NK_BUTTON_LEFT];
         if (lmb.clicked && !lmb.down) {
-          if (state == PickPointState::PickStart) {
+          if (state == PickPointState::PickIsochroneSource) {
+            state = PickPointState::Pending;
+            isochrone.run(query_pool, graph, nearest_node);
+          } else if (state == PickPointState::PickStart) {
             state = PickPointState::PickEnd;
             start = nearest_node;
             start_pos = pos;
@@ -348,11 +780,15 @@ int main(int argc, char *argv[]) {
             end = nearest_node;
             end_pos = pos;
 
-            for (int i = 0; i < algos.size(); ++i) {
+            for (std::size_t i = 0; i < algos.size(); ++i) {
               if (algos[i].enabled) {
-                algos[i].run(i, graph, *start, *end);
+                algos[i].run(query_pool, i, *active, *start, *end,
+                             query_limits(), show_frontier, lockstep);
               }
             }
+            if (alternatives.enabled) {
+              alternatives.run(query_pool, graph, *start, *end);
+            }
           }
         }
       }
@@ -369,7 +805,19 @@ int main(int argc, char *argv[]) {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     map_renderer.render(transform);
+    isochrone_renderer.render(transform);
+    for (std::size_t i = 0; i < algos.size(); ++i) {
+      if (algos[i].enabled) {
+        auto color = algos[i].path_color;
+        color.a *= 0.5f;
+        frontier_renderers[i].render(transform, color);
+      }
+    }
     std::vector<std::size_t> paths;
+    if (alternatives.enabled) {
+      // drawn below the algorithm results
+      paths = alternatives.path_renderer_indices;
+    }
     for (const auto &algo : algos) {
       if (algo.path_renderer_index.has_value() && algo.enabled) {
         paths.push_back(*algo.path_renderer_index);
@@ -381,8 +829,8 @@ int main(int argc, char *argv[]) {
       using enum mapapp::pin_renderer::type;
       if (!nk_item_is_any_active(ctx)) {
         if (state != PickPointState::Pending) {
-          pin_renderer.render(state == PickPointState::PickStart ? SOURCE
-                                                                 : DEST,
+          pin_renderer.render(state == PickPointState::PickEnd ? DEST
+                                                               : SOURCE,
                               mouse_pos, viewport);
         }
       }
@@ -3,11 +3,14 @@
 
 #include <fmt/base.h>
 #include <glm/vec4.hpp>
+#include <charconv>
+#include <initializer_list>
 #include <numeric>
 #include <cstdint>
 #include <osmium/io/pbf_input.hpp>
 #include <osmium/io/reader.hpp>
 #include <osmium/osm/location.hpp>
+#include <osmium/osm/relation.hpp>
 #include <osmium/osm/way.hpp>
 #include <osmium/visitor.hpp>
 
@@ -31,6 +34,77 @@ void map_loader::way(const osmium::Way &way) {
   }
 }
 
+void map_loader::relation(const osmium::Relation &relation) {
+  if (relation.get_value_by_key("type", "") !=
+      std::string_view{"restriction"}) {
+    return;
+  }
+  std::string_view value = relation.get_value_by_key(
+      "restriction", relation.get_value_by_key("restriction:motorcar", ""));
+  restriction r;
+  r.id = relation.id();
+  if (value.starts_with("no_")) {
+    r.r_kind = restriction::kind::NO;
+  } else if (value.starts_with("only_")) {
+    r.r_kind = restriction::kind::ONLY;
+  } else {
+    return;
+  }
+
+  int from = 0, via = 0, to = 0;
+  for (const auto &member : relation.members()) {
+    std::string_view role = member.role();
+    if (role == "from" && member.type() == osmium::item_type::way) {
+      r.from = member.ref();
+      ++from;
+    } else if (role == "via" && member.type() == osmium::item_type::node) {
+      r.via = member.ref();
+      ++via;
+    } else if (role == "to" && member.type() == osmium::item_type::way) {
+      r.to = member.ref();
+      ++to;
+    } else if (role == "via") {
+      // through a way
+      return;
+    }
+  }
+  if (from == 1 && via == 1 && to == 1) {
+    restrictions[r.id] = r;
+  }
+}
+
+namespace {
+// "50", "50 mph". anything else, like "none", "walk" or "RU:urban", is 0.
+float parse_maxspeed(std::string_view value) {
+  float speed = 0.0f;
+  auto [rest, ec] =
+      std::from_chars(value.data(), value.data() + value.size(), speed);
+  if (ec != std::errc{}) {
+    return 0.0f;
+  }
+  std::string_view unit{rest, value.data() + value.size()};
+  if (unit.empty()) {
+    return speed;
+  } else if (unit == " mph" || unit == "mph") {
+    return speed * 1.609344f;
+  }
+  return 0.0f;
+}
+
+// the value of the first of `keys` that is tagged overrides `allowed`
+bool access(const osmium::Way &way, std::initializer_list<const char *> keys,
+            bool allowed) {
+  for (auto key : keys) {
+    if (auto value = way.get_value_by_key(key)) {
+      std::string_view v = value;
+      return v != "no" && v != "private" && v != "agricultural" &&
+             v != "forestry" && v != "delivery" && v != "discouraged";
+    }
+  }
+  return allowed;
+}
+} // namespace
+
 void map_loader::highway(const osmium::Way &way) {
   auto &w = insert(highways, way);
   w.nodes.resize(way.nodes().size());
@@ -38,19 +112,50 @@ void map_loader::highway(const osmium::Way &way) {
   std::transform(way.nodes().begin(), way.nodes().end(), w.nodes.begin(),
                  [&](const auto &n) { return n.ref(); });
   std::string_view highway_type = way.get_value_by_key("highway");
+  // a link is drawn like any other minor road, only its access and speed
+  // follow the road it leads to
+  w.is_link = highway_type.ends_with("_link");
+  if (w.is_link) {
+    highway_type.remove_suffix(5);
+  }
   if (highway_type == "motorway") {
-    w.h_kind = highway::kind::MOTORWAY;
+    w.road_kind = highway::kind::MOTORWAY;
   } else if (highway_type == "trunk") {
-    w.h_kind = highway::kind::TRUNK;
+    w.road_kind = highway::kind::TRUNK;
   } else if (highway_type == "primary") {
-    w.h_kind = highway::kind::PRIMARY;
+    w.road_kind = highway::kind::PRIMARY;
   } else if (highway_type == "secondary") {
-    w.h_kind = highway::kind::SECONDARY;
+    w.road_kind = highway::kind::SECONDARY;
   } else if (highway_type == "tertiary") {
-    w.h_kind = highway::kind::TERTIARY;
+    w.road_kind = highway::kind::TERTIARY;
+  } else if (highway_type == "residential" || highway_type == "unclassified" ||
+             highway_type == "living_street") {
+    w.road_kind = highway::kind::RESIDENTIAL;
+  } else if (highway_type == "service" || highway_type == "track") {
+    w.road_kind = highway::kind::SERVICE;
+  } else if (highway_type == "footway" || highway_type == "path" ||
+             highway_type == "cycleway" || highway_type == "pedestrian" ||
+             highway_type == "steps" || highway_type == "bridleway") {
+    w.road_kind = highway::kind::PATH;
   } else {
-    w.h_kind = highway::kind::OTHER;
+    w.road_kind = highway::kind::OTHER;
   }
+  w.h_kind = w.is_link ? highway::kind::OTHER : w.road_kind;
+  w.maxspeed = parse_maxspeed(way.get_value_by_key("maxspeed", ""));
+
+  // defaults by kind, then the most specific access tag wins
+  bool closed = highway_type == "construction" || highway_type == "proposed" ||
+                highway_type == "abandoned";
+  bool motorway = w.road_kind == highway::kind::MOTORWAY;
+  bool path = w.road_kind == highway::kind::PATH;
+  auto all = access(way, {"access"}, !closed);
+  w.motor_vehicle = access(way, {"motorcar", "motor_vehicle", "vehicle"},
+                           all && !path);
+  w.bicycle = access(way, {"bicycle", "vehicle"},
+                     all && !motorway &&
+                         (!path || highway_type == "cycleway" ||
+                          highway_type == "path"));
+  w.foot = access(way, {"foot"}, all && !motorway);
 }
 
 void map_loader::structure(const osmium::Way &way) {
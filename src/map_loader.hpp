@@ -6,6 +6,7 @@
 #include <osmium/handler.hpp>
 #include <osmium/osm/location.hpp>
 #include <osmium/osm/object.hpp>
+#include <osmium/osm/relation.hpp>
 #include <osmium/osm/types.hpp>
 #include <osmium/osm/way.hpp>
 #include <string>
@@ -37,10 +38,26 @@ struct highway : public way {
     PRIMARY,
     SECONDARY,
     TERTIARY,
+    // also unclassified and living streets
+    RESIDENTIAL,
+    // also tracks
+    SERVICE,
+    // footways, paths, cycleways, pedestrian streets and steps
+    PATH,
     OTHER,
+    NUM_KINDS,
   };
+  // what the way is drawn as, OTHER for links (motorway_link, ...)
   kind h_kind;
+  // what the profiles weigh the way as: `h_kind`, or for a link the kind
+  // of the road it leads to
+  kind road_kind;
+  bool is_link;
   bool oneway;
+  // km/h, 0 if not tagged or not a number
+  float maxspeed;
+  // who may use the way, from its kind and access tags
+  bool motor_vehicle, bicycle, foot;
 };
 
 struct structure : public way {
@@ -55,12 +72,26 @@ struct structure : public way {
   kind s_kind;
 };
 
+// a turn restriction at a single junction: coming from way `from` through
+// node `via`, turning onto way `to` is either forbidden or the only turn
+// allowed. restrictions through a via way are not loaded.
+struct restriction {
+  enum class kind {
+    NO,
+    ONLY,
+  };
+  id_t id;
+  kind r_kind;
+  id_t from, via, to;
+};
+
 class map_loader : public osmium::handler::Handler {
 public:
   void load(const char *path);
 
   void node(const osmium::Node &node);
   void way(const osmium::Way &way);
+  void relation(const osmium::Relation &relation);
 
   void highway(const osmium::Way &way);
   void structure(const osmium::Way &way);
@@ -71,6 +102,7 @@ public:
   MapType<struct node> nodes;
   MapType<struct highway> highways;
   MapType<struct structure> structures;
+  MapType<struct restriction> restrictions;
 
 private:
   decltype(auto) insert(auto &map, const osmium::OSMObject &obj) {
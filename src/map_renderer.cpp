@@ -22,15 +22,8 @@ template <> struct nth<1, glm::vec2> {
 
 namespace mapapp {
 
-struct vertex {
-  glm::vec2 pos;
-  glm::u8vec4 color;
-};
-
-map_renderer::map_renderer(const map_loader &loader) {
-  vao = mapapp::vertex_array::create();
-  vbo = mapapp::buffer::create();
-  shd = mapapp::load_vf_shader(std::array<std::string_view, 2>{R"(
+shader load_map_shader() {
+  return load_vf_shader(std::array<std::string_view, 2>{R"(
 #version 330
 in vec2 pos;
 in vec4 color;
@@ -42,7 +35,7 @@ void main() {
   vf_color = color;
 }
 )",
-                                                               R"(
+                                                        R"(
 #version 330
 in vec4 vf_color;
 out vec4 color;
@@ -50,6 +43,35 @@ void main() {
   color = vf_color;
 }
 )"});
+}
+
+void setup_map_vertex_layout() {
+  auto ptr_cast = [](auto &&value) {
+    return reinterpret_cast<const void *>(static_cast<std::uintptr_t>(value));
+  };
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, false, sizeof(map_vertex),
+                        ptr_cast(offsetof(map_vertex, pos)));
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, true, sizeof(map_vertex),
+                        ptr_cast(offsetof(map_vertex, color)));
+}
+
+void triangulate_polygon(std::vector<map_vertex> &out,
+                         const std::vector<glm::vec2> &outline,
+                         glm::u8vec4 color) {
+  std::array<std::vector<glm::vec2>, 1> input{outline};
+  auto result = mapbox::earcut(input);
+  out.reserve(out.size() + result.size());
+  for (auto idx : result) {
+    out.emplace_back(outline[idx], color);
+  }
+}
+
+map_renderer::map_renderer(const map_loader &loader) {
+  vao = mapapp::vertex_array::create();
+  vbo = mapapp::buffer::create();
+  shd = load_map_shader();
 
   loc_translation = glGetUniformLocation(shd, "translation");
   loc_scale = glGetUniformLocation(shd, "scale");
@@ -99,7 +121,7 @@ void main() {
     }
   };
 
-  std::vector<vertex> vertex_buffer_data;
+  std::vector<map_vertex> vertex_buffer_data;
   for (const auto &[id, highway] : loader.highways) {
     std::vector<glm::vec2> input;
     input.reserve(highway.nodes.size());
@@ -137,15 +159,7 @@ void main() {
                vertex_buffer_data.size() * sizeof(vertex_buffer_data[0]),
                vertex_buffer_data.data(), GL_STATIC_DRAW);
 
-  auto ptr_cast = [](auto &&value) {
-    return reinterpret_cast<const void *>(static_cast<std::uintptr_t>(value));
-  };
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 2, GL_FLOAT, false, sizeof(vertex),
-                        ptr_cast(offsetof(vertex, pos)));
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, true, sizeof(vertex),
-                        ptr_cast(offsetof(vertex, color)));
+  setup_map_vertex_layout();
 }
 
 void map_renderer::render(const camera::transform &transform) {
@@ -3,9 +3,24 @@
 #include "camera.hpp"
 #include "gl.hpp"
 #include "map_loader.hpp"
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
 #include <vector>
 
 namespace mapapp {
+struct map_vertex {
+  glm::vec2 pos;
+  glm::u8vec4 color;
+};
+
+// the colored triangle pipeline used by the map, shared with other overlays
+shader load_map_shader();
+// expects the VAO and VBO to be bound
+void setup_map_vertex_layout();
+void triangulate_polygon(std::vector<map_vertex> &out,
+                         const std::vector<glm::vec2> &outline,
+                         glm::u8vec4 color);
+
 struct map_renderer {
   vertex_array vao;
   buffer vbo;
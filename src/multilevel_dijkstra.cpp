@@ -0,0 +1,351 @@
+#include "multilevel_dijkstra.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <cassert>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <unordered_map>
+
+namespace mapapp {
+namespace {
+using index_t = osm_graph::index_t;
+constexpr auto infinity = std::numeric_limits<double>::infinity();
+
+// a node reached by a search: how far, from where and over which kind of arc,
+// as `cell_arcs` numbers them
+struct label {
+  double dist;
+  index_t parent;
+  std::size_t kind;
+};
+} // namespace
+
+multilevel_overlay::multilevel_overlay(const osm_graph &graph,
+                                       std::size_t num_threads)
+    : graph{graph} {
+  const auto n = graph.nodes.size();
+  std::size_t depth = 0;
+  while (depth < graph_partition::max_depth && (n >> depth) > cell_size) {
+    ++depth;
+  }
+  partition = graph_partition{graph, depth, num_threads};
+
+  for (auto d = depth; d > 0 && levels.size() < max_levels;
+       d = d > level_step ? d - level_step : 0) {
+    auto &lv = levels.emplace_back();
+    lv.depth = d;
+    const auto num_cells = partition.num_cells(d);
+    auto leaves_cell = [&](index_t v, const auto &arcs) {
+      return std::any_of(arcs.begin(), arcs.end(), [&](const auto &arc) {
+        return partition.cell(arc.second, d) != partition.cell(v, d);
+      });
+    };
+    // slots count up in node order within every cell
+    lv.slot.assign(n, no_node);
+    lv.cell_first.assign(num_cells + 1, 0);
+    for (index_t v = 0; v < n; ++v) {
+      if (leaves_cell(v, graph.nodes[v].adj) ||
+          leaves_cell(v, graph.nodes[v].radj)) {
+        lv.slot[v] = lv.cell_first[partition.cell(v, d) + 1]++;
+      }
+    }
+    lv.clique_first.assign(num_cells + 1, 0);
+    for (std::size_t c = 0; c < num_cells; ++c) {
+      auto size = lv.cell_first[c + 1];
+      lv.clique_first[c + 1] = lv.clique_first[c] + size * size;
+      lv.cell_first[c + 1] += lv.cell_first[c];
+    }
+    lv.boundary.resize(lv.cell_first.back());
+    for (index_t v = 0; v < n; ++v) {
+      if (lv.slot[v] != no_node) {
+        lv.boundary[lv.cell_first[partition.cell(v, d)] + lv.slot[v]] = v;
+      }
+    }
+  }
+
+  arc_first.reserve(n + 1);
+  arc_first.push_back(0);
+  for (const auto &node : graph.nodes) {
+    arc_first.push_back(arc_first.back() + node.adj.size());
+  }
+  weights.resize(arc_first.back());
+  customize(weights_of(graph), num_threads);
+}
+
+std::vector<double> multilevel_overlay::weights_of(const osm_graph &graph) {
+  std::vector<double> weights;
+  for (const auto &node : graph.nodes) {
+    for (const auto &[weight, v] : node.adj) {
+      weights.push_back(weight);
+    }
+  }
+  return weights;
+}
+
+void multilevel_overlay::clique_arcs(std::size_t l, index_t v,
+                                     auto fn) const {
+  const auto &lv = levels[l];
+  auto c = cell(l, v);
+  auto first = lv.cell_first[c];
+  auto size = lv.cell_first[c + 1] - first;
+  auto i = lv.slot[v];
+  assert(i != no_node);
+  auto row = lv.clique.begin() + lv.clique_first[c] + i * size;
+  for (std::size_t j = 0; j < size; ++j) {
+    if (j != i) {
+      fn(lv.boundary[first + j], row[j], l + 1);
+    }
+  }
+}
+
+void multilevel_overlay::cell_arcs(std::size_t l, index_t v, auto fn) const {
+  auto c = cell(l, v);
+  const auto &adj = graph.nodes[v].adj;
+  if (l == 0) {
+    for (std::size_t k = 0; k < adj.size(); ++k) {
+      if (auto w = adj[k].second; cell(0, w) == c) {
+        fn(w, weights[arc_first[v] + k], 0);
+      }
+    }
+    return;
+  }
+  clique_arcs(l - 1, v, fn);
+  auto sub = cell(l - 1, v);
+  for (std::size_t k = 0; k < adj.size(); ++k) {
+    if (auto w = adj[k].second; cell(l - 1, w) != sub && cell(l, w) == c) {
+      fn(w, weights[arc_first[v] + k], 0);
+    }
+  }
+}
+
+void multilevel_overlay::customize(std::span<const double> new_weights,
+                                   std::size_t num_threads) {
+  // cells claimed at once from a level
+  constexpr std::size_t chunk = 4;
+  assert(new_weights.size() == weights.size());
+  weights.assign(new_weights.begin(), new_weights.end());
+  for (auto &lv : levels) {
+    lv.clique.assign(lv.clique_first.back(), infinity);
+  }
+
+  // the cells of a level only read the cliques of the level below, so they
+  // need no locks; a level starts once the one below is done
+  num_threads = std::max<std::size_t>(num_threads, 1);
+  std::size_t l = 0;
+  std::atomic<std::size_t> cursor{0};
+  auto next_level = [&]() noexcept {
+    ++l;
+    cursor = 0;
+  };
+  std::barrier level_sync{static_cast<std::ptrdiff_t>(num_threads),
+                          next_level};
+
+  auto work = [&] {
+    // labels of this worker's searches, reset to infinity after each
+    std::vector<double> dist(graph.nodes.size(), infinity);
+    std::vector<index_t> touched;
+    std::vector<std::pair<double, index_t>> queue;
+    while (l < levels.size()) {
+      auto &lv = levels[l];
+      const auto num_cells = lv.cell_first.size() - 1;
+      for (std::size_t c; (c = cursor.fetch_add(chunk)) < num_cells;) {
+        for (auto end = std::min(c + chunk, num_cells); c < end; ++c) {
+          auto first = lv.cell_first[c];
+          auto size = lv.cell_first[c + 1] - first;
+          for (std::size_t i = 0; i < size; ++i) {
+            auto source = lv.boundary[first + i];
+            dist[source] = 0.0;
+            touched.push_back(source);
+            queue.emplace_back(0.0, source);
+            while (!queue.empty()) {
+              std::pop_heap(queue.begin(), queue.end(), std::greater<>{});
+              auto [d, u] = queue.back();
+              queue.pop_back();
+              if (d > dist[u]) {
+                continue;
+              }
+              cell_arcs(l, u, [&](index_t w, double weight, std::size_t) {
+                if (auto next = d + weight; next < dist[w]) {
+                  if (dist[w] == infinity) {
+                    touched.push_back(w);
+                  }
+                  dist[w] = next;
+                  queue.emplace_back(next, w);
+                  std::push_heap(queue.begin(), queue.end(), std::greater<>{});
+                }
+              });
+            }
+            auto row = lv.clique.begin() + lv.clique_first[c] + i * size;
+            for (std::size_t j = 0; j < size; ++j) {
+              row[j] = dist[lv.boundary[first + j]];
+            }
+            for (auto v : touched) {
+              dist[v] = infinity;
+            }
+            touched.clear();
+          }
+        }
+      }
+      level_sync.arrive_and_wait();
+    }
+  };
+
+  std::vector<std::jthread> helpers;
+  for (std::size_t id = 1; id < num_threads; ++id) {
+    helpers.emplace_back(work);
+  }
+  work();
+}
+
+pathfind_result multilevel_overlay::query(std::stop_token token,
+                                          index_t start, index_t end,
+                                          const search_limits &limits) const {
+  pathfind_result result;
+  search_control control{token, limits, &result.mem_stat};
+  if (!graph.may_reach(start, end)) {
+    return result;
+  }
+
+  // how many levels up the cell of `v` holds neither `start` nor `end`. the
+  // cells nest, so once one does every cell above does too.
+  auto query_level = [&](index_t v) {
+    std::size_t q = 0;
+    while (q < levels.size() && cell(q, v) != cell(q, start) &&
+           cell(q, v) != cell(q, end)) {
+      ++q;
+    }
+    return q;
+  };
+
+  pf_map<index_t, label> labels{&result.mem_stat};
+  pf_vector<std::pair<double, index_t>> queue{&result.mem_stat};
+  labels.emplace(start, label{0.0, no_node, 0});
+  queue.emplace_back(0.0, start);
+  result.counters.push(queue.size());
+
+  auto relax = [&](index_t u, double d) {
+    return [&, u, d](index_t w, double weight, std::size_t kind) {
+      result.counters.relax();
+      if (weight == infinity) {
+        return;
+      }
+      auto next = d + weight;
+      auto [it, inserted] = labels.try_emplace(w, label{next, u, kind});
+      if (!inserted) {
+        if (next >= it->second.dist) {
+          return;
+        }
+        it->second = {next, u, kind};
+        result.counters.decrease_key();
+      }
+      queue.emplace_back(next, w);
+      std::push_heap(queue.begin(), queue.end(), std::greater<>{});
+      result.counters.push(queue.size());
+    };
+  };
+
+  bool found = false;
+  while (!queue.empty()) {
+    std::pop_heap(queue.begin(), queue.end(), std::greater<>{});
+    auto [d, u] = queue.back();
+    queue.pop_back();
+    result.counters.pop();
+    if (d > labels.at(u).dist) {
+      continue;
+    }
+    if (control.expand()) {
+      break;
+    }
+    result.counters.settle();
+    control.settle(u);
+    if (u == end) {
+      found = true;
+      break;
+    }
+
+    // the roads near `start` and `end`, elsewhere the clique of the cell and
+    // the roads out of it
+    const auto &adj = graph.nodes[u].adj;
+    auto fn = relax(u, d);
+    if (auto q = query_level(u); q == 0) {
+      for (std::size_t k = 0; k < adj.size(); ++k) {
+        fn(adj[k].second, weights[arc_first[u] + k], 0);
+      }
+    } else {
+      clique_arcs(q - 1, u, fn);
+      auto c = cell(q - 1, u);
+      for (std::size_t k = 0; k < adj.size(); ++k) {
+        if (auto w = adj[k].second; cell(q - 1, w) != c) {
+          fn(w, weights[arc_first[u] + k], 0);
+        }
+      }
+    }
+  }
+  result.stopped = control.stopped();
+  if (!found || labels.at(end).dist == infinity) {
+    return result;
+  }
+
+  std::vector<std::pair<index_t, std::size_t>> legs;
+  for (auto v = end; v != start; v = labels.at(v).parent) {
+    legs.emplace_back(v, labels.at(v).kind);
+  }
+  std::vector<index_t> forward{start};
+  for (auto it = legs.rbegin(); it != legs.rend(); ++it) {
+    if (auto [v, kind] = *it; kind == 0) {
+      forward.push_back(v);
+    } else {
+      unpack(kind - 1, forward.back(), v, forward);
+    }
+  }
+  result.path.assign(forward.rbegin(), forward.rend());
+  result.distance = labels.at(end).dist;
+  return result;
+}
+
+void multilevel_overlay::unpack(std::size_t l, index_t from, index_t to,
+                                std::vector<index_t> &out) const {
+  std::unordered_map<index_t, label> labels;
+  std::vector<std::pair<double, index_t>> queue;
+  labels.emplace(from, label{0.0, no_node, 0});
+  queue.emplace_back(0.0, from);
+  while (!queue.empty()) {
+    std::pop_heap(queue.begin(), queue.end(), std::greater<>{});
+    auto [d, u] = queue.back();
+    queue.pop_back();
+    if (d > labels.at(u).dist) {
+      continue;
+    }
+    if (u == to) {
+      break;
+    }
+    cell_arcs(l, u, [&](index_t w, double weight, std::size_t kind) {
+      auto next = d + weight;
+      auto [it, inserted] = labels.try_emplace(w, label{next, u, kind});
+      if (!inserted) {
+        if (next >= it->second.dist) {
+          return;
+        }
+        it->second = {next, u, kind};
+      }
+      queue.emplace_back(next, w);
+      std::push_heap(queue.begin(), queue.end(), std::greater<>{});
+    });
+  }
+
+  std::vector<std::pair<index_t, std::size_t>> legs;
+  for (auto v = to; v != from; v = labels.at(v).parent) {
+    legs.emplace_back(v, labels.at(v).kind);
+  }
+  for (auto it = legs.rbegin(); it != legs.rend(); ++it) {
+    if (auto [v, kind] = *it; kind == 0) {
+      out.push_back(v);
+    } else {
+      unpack(kind - 1, out.back(), v, out);
+    }
+  }
+}
+} // namespace mapapp
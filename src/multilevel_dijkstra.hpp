@@ -0,0 +1,94 @@
+#pragma once
+
+#include "partition.hpp"
+#include "pathfind.hpp"
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <span>
+#include <stop_token>
+#include <vector>
+
+namespace mapapp {
+// multi-level Dijkstra on a customizable route planning overlay (Delling,
+// Goldberg, Pajor & Werneck). the graph is cut into nested cells; on every
+// level each cell keeps a clique between its boundary nodes, those with an
+// arc to another cell of the level, weighted by the shortest paths inside the
+// cell. a query walks the roads of the cells holding its start and end and,
+// everywhere else, the cliques of the highest level whose cell holds neither.
+// like `customizable_contraction_hierarchy` the structure only depends on the
+// roads: new weights only cost a `customize`, cell by cell in parallel.
+struct multilevel_overlay {
+  using index_t = osm_graph::index_t;
+  static constexpr auto no_node = static_cast<index_t>(-1);
+  // cells of the lowest level have about this many nodes, those of every
+  // level above are 2^level_step times as large
+  static constexpr std::size_t cell_size = 256, level_step = 3, max_levels = 4;
+
+  struct level {
+    // bisection depth of `partition` the cells are taken from
+    std::size_t depth;
+    // boundary nodes of every cell, those of cell c in
+    // [cell_first[c], cell_first[c + 1])
+    std::vector<std::size_t> cell_first;
+    std::vector<index_t> boundary;
+    // position of every node among the boundary nodes of its cell, `no_node`
+    // inside the cell
+    std::vector<index_t> slot;
+    // the clique of cell c as a matrix of size b * b at clique_first[c]: the
+    // weight from its i-th to its j-th boundary node is at i * b + j,
+    // infinity if there is no path inside the cell
+    std::vector<std::size_t> clique_first;
+    std::vector<double> clique;
+  };
+
+  const osm_graph &graph;
+  graph_partition partition;
+  // lowest first
+  std::vector<level> levels;
+  // the metric, one weight per arc in the order of `weights_of`: arcs of node
+  // u from arc_first[u]
+  std::vector<std::size_t> arc_first;
+  std::vector<double> weights;
+
+  // partitions the graph and customizes the overlay with its own weights.
+  // the calling thread is one of the `num_threads` workers.
+  explicit multilevel_overlay(
+      const osm_graph &graph,
+      std::size_t num_threads = thread_pool::default_size());
+  multilevel_overlay(const multilevel_overlay &) = delete;
+  auto operator=(const multilevel_overlay &) = delete;
+
+  // the arc weights of `graph` in the order `customize` takes: node by node,
+  // each node's arcs in the order of `adj`
+  static std::vector<double> weights_of(const osm_graph &graph);
+
+  // replaces the metric and recomputes every clique, infinity closes an arc.
+  // the calling thread is one of the `num_threads` workers.
+  void customize(std::span<const double> weights,
+                 std::size_t num_threads = thread_pool::default_size());
+
+  // cell of `node` on `levels[l]`
+  std::uint32_t cell(std::size_t l, index_t node) const {
+    return partition.cell(node, levels[l].depth);
+  }
+
+  // arguments and path are node indices, the path runs from `end` to `start`
+  // like those of the other searches
+  pathfind_result query(std::stop_token token, index_t start, index_t end,
+                        const search_limits &limits = {}) const;
+
+  // appends the nodes of the shortest path `from -> to` inside their cell of
+  // `levels[l]`, excluding `from`. both are boundary nodes of that cell.
+  void unpack(std::size_t l, index_t from, index_t to,
+              std::vector<index_t> &out) const;
+
+private:
+  // calls fn(head, weight, l + 1) for the clique arcs of `v` on `levels[l]`
+  void clique_arcs(std::size_t l, index_t v, auto fn) const;
+  // calls fn(head, weight, kind) for the arcs a search inside the cell of `v`
+  // on `levels[l]` takes: the roads of the cell on the lowest level, else the
+  // cliques of the level below and the roads between its cells. `kind` is 0
+  // for a road, else one more than the level of the clique.
+  void cell_arcs(std::size_t l, index_t v, auto fn) const;
+};
+} // namespace mapapp
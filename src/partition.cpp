@@ -0,0 +1,363 @@
+#include "partition.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <glm/geometric.hpp>
+#include <istream>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace mapapp {
+namespace {
+using index_t = osm_graph::index_t;
+constexpr auto none = static_cast<index_t>(-1);
+constexpr std::array<glm::vec2, 4> directions{
+    glm::vec2{1, 0}, glm::vec2{0, 1}, glm::vec2{1, 1}, glm::vec2{1, -1}};
+constexpr std::string_view magic = "mapapp-partition";
+constexpr int version = 1;
+} // namespace
+
+std::vector<std::vector<index_t>>
+undirected_neighbours(const osm_graph &graph) {
+  std::vector<std::vector<index_t>> neighbours(graph.nodes.size());
+  for (index_t u = 0; u < graph.nodes.size(); ++u) {
+    for (const auto &[weight, v] : graph.nodes[u].adj) {
+      if (u != v) {
+        neighbours[u].push_back(v);
+        neighbours[v].push_back(u);
+      }
+    }
+  }
+  for (auto &list : neighbours) {
+    std::sort(list.begin(), list.end());
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+  }
+  return neighbours;
+}
+
+inertial_flow::inertial_flow(
+    const osm_graph &graph,
+    const std::vector<std::vector<osm_graph::index_t>> &neighbours)
+    : graph{graph}, neighbours{neighbours}, local(graph.nodes.size(), none) {}
+
+bisection inertial_flow::operator()(std::span<const index_t> cell) {
+  const auto k = cell.size();
+  assert(k >= 2);
+  for (index_t i = 0; i < k; ++i) {
+    local[cell[i]] = i;
+  }
+  first.assign(1, 0);
+  head.clear();
+  for (index_t i = 0; i < k; ++i) {
+    for (auto w : neighbours[cell[i]]) {
+      if (local[w] != none) {
+        head.push_back(local[w]);
+      }
+    }
+    first.push_back(head.size());
+  }
+  // the arcs of a node are sorted by the index of their heads in the graph,
+  // so the opposite one is found by bisection
+  opposite.resize(head.size());
+  for (index_t u = 0; u < k; ++u) {
+    for (auto a = first[u]; a < first[u + 1]; ++a) {
+      auto v = head[a];
+      auto it = std::lower_bound(
+          head.begin() + first[v], head.begin() + first[v + 1], u,
+          [&](index_t x, index_t key) { return cell[x] < cell[key]; });
+      opposite[a] = it - head.begin();
+    }
+  }
+
+  const auto ends =
+      std::max<std::size_t>(1, static_cast<std::size_t>(k * balance));
+  order.resize(k);
+  std::iota(order.begin(), order.end(), index_t{0});
+  std::vector<bool> best(k);
+  auto best_cut = std::numeric_limits<std::size_t>::max();
+  auto best_imbalance = k;
+  for (auto direction : directions) {
+    auto by_projection = [&](index_t a, index_t b) {
+      return glm::dot(graph.nodes[cell[a]].position, direction) <
+             glm::dot(graph.nodes[cell[b]].position, direction);
+    };
+    std::nth_element(order.begin(), order.begin() + ends, order.end(),
+                     by_projection);
+    std::nth_element(order.begin() + ends, order.end() - ends, order.end(),
+                     by_projection);
+    roles.assign(k, role::NONE);
+    for (std::size_t i = 0; i < ends; ++i) {
+      roles[order[i]] = role::SOURCE;
+      roles[order[k - 1 - i]] = role::SINK;
+    }
+    flow.assign(head.size(), 0);
+    auto cut = max_flow();
+    if (cut > best_cut) {
+      continue;
+    }
+    // the cut nearest the sources and the one nearest the sinks are both
+    // minimal, the one closer to halving the cell is taken
+    auto near_sources = static_cast<std::size_t>(std::count_if(
+        level.begin(), level.end(), [](int l) { return l >= 0; }));
+    auto near_sinks = k - sinks_reached();
+    for (bool sink_side : {false, true}) {
+      auto size = sink_side ? near_sinks : near_sources;
+      auto imbalance = std::max(size, k - size);
+      if (cut < best_cut || imbalance < best_imbalance) {
+        best_cut = cut;
+        best_imbalance = imbalance;
+        for (index_t i = 0; i < k; ++i) {
+          best[i] = sink_side ? !reaches_sink[i] : level[i] >= 0;
+        }
+      }
+    }
+  }
+
+  // `best` holds the side of the sources
+  bisection result;
+  for (index_t i = 0; i < k; ++i) {
+    result.sides[best[i] ? 0 : 1].push_back(cell[i]);
+    if (best[i]) {
+      for (auto a = first[i]; a < first[i + 1]; ++a) {
+        if (!best[head[a]]) {
+          result.cut.emplace_back(cell[i], cell[head[a]]);
+        }
+      }
+    }
+  }
+  for (auto v : cell) {
+    local[v] = none;
+  }
+  return result;
+}
+
+// Dinic's algorithm. with unit capacities every phase is a BFS and a walk
+// over each arc at most once, and there are few phases. `level` is left with
+// what the sources reach once the flow is maximal.
+std::size_t inertial_flow::max_flow() {
+  const auto k = first.size() - 1;
+  std::size_t total = 0;
+  while (true) {
+    level.assign(k, -1);
+    queue.clear();
+    for (index_t i = 0; i < k; ++i) {
+      if (roles[i] == role::SOURCE) {
+        level[i] = 0;
+        queue.push_back(i);
+      }
+    }
+    bool reached = false;
+    for (std::size_t q = 0; q < queue.size(); ++q) {
+      auto u = queue[q];
+      if (roles[u] == role::SINK) {
+        reached = true;
+        continue;
+      }
+      for (auto a = first[u]; a < first[u + 1]; ++a) {
+        if (flow[a] < 1 && level[head[a]] < 0) {
+          level[head[a]] = level[u] + 1;
+          queue.push_back(head[a]);
+        }
+      }
+    }
+    if (!reached) {
+      return total;
+    }
+
+    // paths one level at a time from every source to any sink. a node that
+    // leads nowhere is dropped for the rest of the phase.
+    current.assign(first.begin(), first.end() - 1);
+    for (index_t s = 0; s < k; ++s) {
+      if (roles[s] != role::SOURCE) {
+        continue;
+      }
+      auto x = s;
+      path.clear();
+      while (true) {
+        if (roles[x] == role::SINK) {
+          for (auto a : path) {
+            ++flow[a];
+            --flow[opposite[a]];
+          }
+          ++total;
+          path.clear();
+          x = s;
+          continue;
+        }
+        auto &a = current[x];
+        while (a < first[x + 1] &&
+               (flow[a] == 1 || level[head[a]] != level[x] + 1)) {
+          ++a;
+        }
+        if (a < first[x + 1]) {
+          path.push_back(a);
+          x = head[a];
+          continue;
+        }
+        if (path.empty()) {
+          break;
+        }
+        level[x] = -1;
+        x = head[opposite[path.back()]];
+        path.pop_back();
+        ++current[x];
+      }
+    }
+  }
+}
+
+// marks in `reaches_sink` the nodes a sink can still be reached from in the
+// residual graph, returns how many there are
+std::size_t inertial_flow::sinks_reached() {
+  const auto k = first.size() - 1;
+  reaches_sink.assign(k, false);
+  queue.clear();
+  for (index_t i = 0; i < k; ++i) {
+    if (roles[i] == role::SINK) {
+      reaches_sink[i] = true;
+      queue.push_back(i);
+    }
+  }
+  for (std::size_t q = 0; q < queue.size(); ++q) {
+    auto u = queue[q];
+    for (auto a = first[u]; a < first[u + 1]; ++a) {
+      if (flow[opposite[a]] < 1 && !reaches_sink[head[a]]) {
+        reaches_sink[head[a]] = true;
+        queue.push_back(head[a]);
+      }
+    }
+  }
+  return queue.size();
+}
+
+graph_partition::graph_partition(const osm_graph &graph, std::size_t depth,
+                                 std::size_t num_threads)
+    : depth{depth}, code(graph.nodes.size(), 0) {
+  assert(depth <= max_depth);
+  const auto n = graph.nodes.size();
+  if (depth == 0 || n < 2) {
+    return;
+  }
+  auto neighbours = undirected_neighbours(graph);
+
+  // cells waiting to be split. the workers stop once there are none and no
+  // split is running that could add more.
+  struct job {
+    std::vector<index_t> nodes;
+    std::size_t level;
+  };
+  std::vector<job> jobs;
+  jobs.push_back({std::vector<index_t>(n), 0});
+  std::iota(jobs.back().nodes.begin(), jobs.back().nodes.end(), index_t{0});
+  std::size_t running = 0;
+  std::mutex mtx;
+  std::condition_variable cv;
+
+  auto work = [&] {
+    inertial_flow bisect{graph, neighbours};
+    std::unique_lock lock{mtx};
+    while (true) {
+      cv.wait(lock, [&] { return !jobs.empty() || running == 0; });
+      if (jobs.empty()) {
+        return;
+      }
+      auto [nodes, level] = std::move(jobs.back());
+      jobs.pop_back();
+      ++running;
+      lock.unlock();
+
+      auto halves = bisect(nodes);
+      // every node is in one cell at a time, so only one worker writes it
+      for (auto v : halves.sides[1]) {
+        code[v] |= std::uint32_t{1} << (depth - 1 - level);
+      }
+
+      lock.lock();
+      --running;
+      if (level + 1 < depth) {
+        for (auto &side : halves.sides) {
+          if (side.size() >= 2) {
+            jobs.push_back({std::move(side), level + 1});
+          }
+        }
+      }
+      cv.notify_all();
+    }
+  };
+  std::vector<std::jthread> helpers;
+  for (std::size_t id = 1; id < num_threads; ++id) {
+    helpers.emplace_back(work);
+  }
+  work();
+}
+
+std::vector<graph_partition::level_statistics>
+graph_partition::statistics(const osm_graph &graph) const {
+  const auto n = graph.nodes.size();
+  std::vector<level_statistics> levels(depth);
+  std::vector<std::uint32_t> cells(n);
+  for (std::size_t l = 1; l <= depth; ++l) {
+    auto &stats = levels[l - 1];
+    for (index_t u = 0; u < n; ++u) {
+      cells[u] = cell(u, l);
+      for (const auto &[weight, v] : graph.nodes[u].adj) {
+        stats.cut_arcs += cell(u, l) != cell(v, l);
+      }
+    }
+    std::sort(cells.begin(), cells.end());
+    stats.min_cell = n;
+    for (std::size_t i = 0; i < n;) {
+      auto j = i;
+      while (j < n && cells[j] == cells[i]) {
+        ++j;
+      }
+      ++stats.cells;
+      stats.min_cell = std::min(stats.min_cell, j - i);
+      stats.max_cell = std::max(stats.max_cell, j - i);
+      i = j;
+    }
+  }
+  return levels;
+}
+
+void graph_partition::save(std::ostream &out, const osm_graph &graph) const {
+  out << magic << ' ' << version << '\n'
+      << graph.nodes.size() << ' ' << depth << '\n';
+  for (index_t u = 0; u < graph.nodes.size(); ++u) {
+    out << graph.nodes[u].id << ' ' << code[u] << '\n';
+  }
+}
+
+graph_partition graph_partition::load(std::istream &in,
+                                      const osm_graph &graph) {
+  std::string name;
+  int file_version = 0;
+  std::size_t num_nodes = 0;
+  graph_partition partition;
+  in >> name >> file_version >> num_nodes >> partition.depth;
+  if (!in || name != magic || file_version != version) {
+    throw std::runtime_error{"not a partition file"};
+  }
+  if (num_nodes != graph.nodes.size() || partition.depth > max_depth) {
+    throw std::runtime_error{"partition does not fit the graph"};
+  }
+  partition.code.resize(num_nodes);
+  for (index_t u = 0; u < num_nodes; ++u) {
+    id_t id;
+    in >> id >> partition.code[u];
+    if (!in || id != graph.nodes[u].id ||
+        (partition.depth < max_depth &&
+         partition.code[u] >> partition.depth != 0)) {
+      throw std::runtime_error{"partition does not fit the graph"};
+    }
+  }
+  return partition;
+}
+} // namespace mapapp
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "pathfind.hpp"
+#include "thread_pool.hpp"
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace mapapp {
+// neighbours of every node in either direction, sorted, without loops or
+// duplicates
+std::vector<std::vector<osm_graph::index_t>>
+undirected_neighbours(const osm_graph &graph);
+
+// the two halves of a cell and the edges between them
+struct bisection {
+  std::array<std::vector<osm_graph::index_t>, 2> sides;
+  // (node in `sides[0]`, node in `sides[1]`)
+  std::vector<std::pair<osm_graph::index_t, osm_graph::index_t>> cut;
+};
+
+// inertial flow (Schild & Sommer): the nodes of a cell are sorted along a
+// line, the first and last `balance` of them become sources and sinks, and a
+// minimum cut between them splits the cell. every edge has capacity 1, so
+// the cut has the fewest edges of any split that keeps both ends apart; the
+// best of four directions is taken. one instance per thread, it keeps a
+// workspace the size of the graph.
+class inertial_flow {
+public:
+  // share of a cell taken as sources and as sinks, each half gets at least
+  // this much of it
+  static constexpr double balance = 0.25;
+
+  inertial_flow(const osm_graph &graph,
+                const std::vector<std::vector<osm_graph::index_t>> &neighbours);
+
+  // `cell` needs at least two nodes
+  bisection operator()(std::span<const osm_graph::index_t> cell);
+
+private:
+  using index_t = osm_graph::index_t;
+
+  // the flow of the current direction, the cut size if it is done
+  std::size_t max_flow();
+  std::size_t sinks_reached();
+
+  const osm_graph &graph;
+  const std::vector<std::vector<index_t>> &neighbours;
+  // local index of every node of the current cell, `none` elsewhere
+  std::vector<index_t> local;
+  // the subgraph the cell induces: arcs of local node i in
+  // [first[i], first[i + 1]), each with its head, the opposite arc and its
+  // flow, -1, 0 or 1
+  std::vector<std::size_t> first, opposite, current;
+  std::vector<index_t> head;
+  std::vector<std::int8_t> flow;
+  enum class role : std::uint8_t { NONE, SOURCE, SINK };
+  std::vector<role> roles;
+  // BFS distance from the sources in the residual graph, -1 if unreached
+  std::vector<int> level;
+  std::vector<bool> reaches_sink;
+  std::vector<index_t> order, queue;
+  std::vector<std::size_t> path;
+};
+
+// recursive bisection of the whole graph: every cell is split in two by
+// `inertial_flow` until `depth` levels are reached or cells have a single
+// node. cells are numbered by the sides taken on the way down, so the cells
+// of a level nest in those of the level above.
+struct graph_partition {
+  using index_t = osm_graph::index_t;
+  static constexpr std::size_t max_depth = 32;
+
+  struct level_statistics {
+    std::size_t cells = 0;
+    // arcs between different cells of the level
+    std::size_t cut_arcs = 0;
+    std::size_t min_cell = 0, max_cell = 0;
+  };
+
+  std::size_t depth = 0;
+  // per node, the side taken at every level: level 1 in the highest of
+  // `depth` bits
+  std::vector<std::uint32_t> code;
+
+  graph_partition() = default;
+  // cells split in parallel once they are independent. the calling thread is
+  // one of the `num_threads` workers.
+  graph_partition(const osm_graph &graph, std::size_t depth,
+                  std::size_t num_threads = thread_pool::default_size());
+
+  // level 0 is one cell with every node, level `depth` the finest
+  std::uint32_t cell(index_t node, std::size_t level) const {
+    return level == 0 ? 0 : code[node] >> (depth - level);
+  }
+  std::size_t num_cells(std::size_t level) const {
+    return std::size_t{1} << level;
+  }
+
+  // levels 1 to `depth`
+  std::vector<level_statistics> statistics(const osm_graph &graph) const;
+
+  // text, one line per node with its id. `load` throws std::runtime_error if
+  // the file was not saved for the same graph.
+  void save(std::ostream &out, const osm_graph &graph) const;
+  static graph_partition load(std::istream &in, const osm_graph &graph);
+};
+} // namespace mapapp
@@ -1,17 +1,128 @@
 #include "pathfind.hpp"
+#include "arc_flags.hpp"
 #include "map_loader.hpp"
+#include "routing_profile.hpp"
 #include "spherical.hpp"
+#include <algorithm>
 #include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <deque>
 #include <fmt/base.h>
 #include <fmt/xchar.h>
 #include <memory>
+#include <numeric>
 #include <optional>
 #include <set>
 
 namespace mapapp {
-osm_graph::osm_graph(const map_loader &map) : nn_tree{2, nodes} {
+namespace {
+// at a junction with turn restrictions, every approach that one of them
+// applies to gets its own copy of the junction. arcs from that neighbour lead
+// into the copy, and the copy only has the arcs the approach may continue on.
+// other approaches keep the junction itself, so the graph grows by one node
+// per restricted approach. copies share the id and position of the junction.
+void split_restricted_junctions(const map_loader &map,
+                                osm_graph::node_vector &nodes,
+                                const std::map<id_t, osm_graph::index_t>
+                                    &node_index_map) {
+  using index_t = osm_graph::index_t;
+  // the junction each node is a copy of, itself if none. restrictions name
+  // their ways, so arcs are matched against the neighbours along them by
+  // origin: a neighbour may have been split already.
+  std::vector<index_t> origin(nodes.size());
+  std::iota(origin.begin(), origin.end(), index_t{0});
+
+  // neighbours of `via` along `way`
+  auto neighbours = [&](const highway &way, id_t via) {
+    std::vector<index_t> result;
+    for (std::size_t i = 0; i < way.nodes.size(); ++i) {
+      if (way.nodes[i] != via) {
+        continue;
+      }
+      if (i > 0) {
+        result.push_back(node_index_map.at(way.nodes[i - 1]));
+      }
+      if (i + 1 < way.nodes.size()) {
+        result.push_back(node_index_map.at(way.nodes[i + 1]));
+      }
+    }
+    return result;
+  };
+
+  // via -> neighbour approached from -> (kind, neighbours turned onto)
+  using rule = std::pair<restriction::kind, std::vector<index_t>>;
+  std::map<index_t, std::map<index_t, std::vector<rule>>> junctions;
+  for (const auto &[_, r] : map.restrictions) {
+    auto via = node_index_map.find(r.via);
+    auto from = map.highways.find(r.from);
+    auto to = map.highways.find(r.to);
+    if (via == node_index_map.end() || from == map.highways.end() ||
+        to == map.highways.end()) {
+      continue;
+    }
+    auto to_neighbours = neighbours(to->second, r.via);
+    if (to_neighbours.empty()) {
+      continue;
+    }
+    for (auto f : neighbours(from->second, r.via)) {
+      junctions[via->second][f].emplace_back(r.r_kind, to_neighbours);
+    }
+  }
+
+  for (const auto &[v, approaches] : junctions) {
+    for (const auto &[f, rules] : approaches) {
+      auto from_f = [&](const auto &arc) { return origin[arc.second] == f; };
+      if (std::none_of(nodes[v].radj.begin(), nodes[v].radj.end(), from_f)) {
+        // no arc into the junction from there, e.g. against a one-way
+        continue;
+      }
+      auto allowed = [&](index_t t) {
+        return std::all_of(rules.begin(), rules.end(), [&](const rule &r) {
+          auto onto = std::find(r.second.begin(), r.second.end(), t) !=
+                      r.second.end();
+          return onto == (r.first == restriction::kind::ONLY);
+        });
+      };
+
+      index_t c = nodes.size();
+      auto &copy = nodes.emplace_back();
+      copy.id = nodes[v].id;
+      copy.location = nodes[v].location;
+      copy.position = nodes[v].position;
+      origin.push_back(v);
+      for (auto [weight, t] : nodes[v].adj) {
+        if (allowed(origin[t])) {
+          nodes[c].adj.emplace_back(weight, t);
+          nodes[t].radj.emplace_back(weight, c);
+        }
+      }
+      std::set<index_t> tails;
+      std::erase_if(nodes[v].radj, [&](const auto &arc) {
+        if (!from_f(arc)) {
+          return false;
+        }
+        nodes[c].radj.push_back(arc);
+        tails.insert(arc.second);
+        return true;
+      });
+      for (auto x : tails) {
+        for (auto &arc : nodes[x].adj) {
+          if (arc.second == v) {
+            arc.second = c;
+          }
+        }
+      }
+    }
+  }
+}
+
+// every node of a highway, with arcs along the ways `profile` may use
+osm_graph::node_vector highway_nodes(const map_loader &map,
+                                     const routing_profile *profile) {
+  using index_t = osm_graph::index_t;
+  osm_graph::node_vector nodes;
+  std::map<id_t, index_t> node_index_map;
   index_t index = 0;
   std::set<id_t> highway_nodes;
   for (const auto &[_, way] : map.highways) {
@@ -26,198 +137,297 @@ osm_graph::osm_graph(const map_loader &map) : nn_tree{2, nodes} {
     n.position = node.position;
   }
   for (const auto &[_, way] : map.highways) {
+    // seconds per metre
+    double pace = 1.0;
+    if (profile) {
+      auto speed = profile->way_speed(way);
+      if (speed <= 0.0) {
+        continue;
+      }
+      pace = 3.6 / speed;
+    }
+    bool oneway = way.oneway && (!profile || profile->obeys_oneway());
     index_t prev = -1;
     for (const auto node : way.nodes) {
       auto cur = node_index_map[node];
       if (prev != static_cast<index_t>(-1)) {
         auto prev_loc = nodes[prev].location;
         auto cur_loc = nodes[cur].location;
-        auto distance = spherical_distance(prev_loc, cur_loc);
-        nodes[prev].adj.emplace_back(distance, cur);
-        if(!way.oneway) {
-          nodes[cur].adj.emplace_back(distance, prev);
+        auto weight = spherical_distance(prev_loc, cur_loc) * pace;
+        nodes[prev].adj.emplace_back(weight, cur);
+        nodes[cur].radj.emplace_back(weight, prev);
+        if(!oneway) {
+          nodes[cur].adj.emplace_back(weight, prev);
+          nodes[prev].radj.emplace_back(weight, cur);
         }
       }
       prev = cur;
     }
   }
+  if (!profile || profile->obeys_restrictions()) {
+    split_restricted_junctions(map, nodes, node_index_map);
+  }
+  return nodes;
+}
+} // namespace
+
+osm_graph::osm_graph(const map_loader &map, const routing_profile *profile,
+                     bool snap_to_largest_component)
+    : osm_graph{highway_nodes(map, profile),
+                profile ? profile->max_speed / 3.6 : 1.0,
+                snap_to_largest_component} {}
+
+osm_graph::osm_graph(node_vector vertices, double max_speed,
+                     bool snap_to_largest_component)
+    : nodes{std::move(vertices)}, max_speed{max_speed}, nn_tree{2, snap} {
+  // a junction split for turn restrictions shares its id with its copies.
+  // none of them is a snap point, a query from or to one would have to pick
+  // an approach. `node_index_map` holds the junction itself.
+  std::vector<bool> split(nodes.size());
+  for (index_t i = 0; i < nodes.size(); ++i) {
+    auto [it, inserted] = node_index_map.emplace(nodes[i].id, i);
+    if (!inserted) {
+      split[i] = split[it->second] = true;
+    }
+  }
   for (auto &node : nodes) {
     std::sort(node.adj.begin(), node.adj.end());
+    std::sort(node.radj.begin(), node.radj.end());
   }
 
+  find_components();
+  for (index_t i = 0; i < nodes.size(); ++i) {
+    if (!split[i] &&
+        (!snap_to_largest_component || component[i] == largest_component)) {
+      snap.indices.push_back(i);
+    }
+  }
   nn_tree.buildIndex();
 }
 
-osm_graph::index_t osm_graph::nn_query(glm::dvec2 pos) {
-  auto out_index = static_cast<std::size_t>(-1);
-  double dummy;
-  nn_tree.knnSearch(&pos[0], 1, &out_index, &dummy);
-  return out_index;
-}
+// Tarjan's algorithm with an explicit stack, so that long roads cannot
+// overflow the call stack
+void osm_graph::find_components() {
+  constexpr auto none = static_cast<index_t>(-1);
+  const auto n = nodes.size();
+  component.assign(n, none);
+  num_components = 0;
+
+  // discovery order and lowest order reachable through the DFS subtree. a
+  // node is on the component stack while it is discovered but has no
+  // component yet.
+  std::vector<index_t> order(n, none), low(n);
+  std::vector<index_t> open;
+  // (node, next arc)
+  std::vector<std::pair<index_t, std::size_t>> calls;
+  std::vector<index_t> sizes;
+  index_t next_order = 0;
+
+  for (index_t root = 0; root < n; ++root) {
+    if (order[root] != none) {
+      continue;
+    }
+    order[root] = low[root] = next_order++;
+    open.push_back(root);
+    calls.emplace_back(root, 0);
+    while (!calls.empty()) {
+      auto &[v, arc] = calls.back();
+      const auto &adj = nodes[v].adj;
+      if (arc < adj.size()) {
+        auto w = adj[arc++].second;
+        if (order[w] == none) {
+          order[w] = low[w] = next_order++;
+          open.push_back(w);
+          // note: `v` and `arc` are invalidated here
+          calls.emplace_back(w, 0);
+        } else if (component[w] == none) {
+          low[v] = std::min(low[v], order[w]);
+        }
+        continue;
+      }
 
-void memory_statistics::alloc(std::size_t size) {
-  total_allocated += size;
-  cur_allocated += size;
-  max_allocated = std::max(max_allocated, cur_allocated);
-}
+      auto node = v;
+      calls.pop_back();
+      if (low[node] == order[node]) {
+        index_t size = 0, w;
+        do {
+          w = open.back();
+          open.pop_back();
+          component[w] = num_components;
+          ++size;
+        } while (w != node);
+        sizes.push_back(size);
+        ++num_components;
+      }
+      if (!calls.empty()) {
+        auto parent = calls.back().first;
+        low[parent] = std::min(low[parent], low[node]);
+      }
+    }
+  }
 
-void memory_statistics::free(std::size_t size) {
-  assert(size <= cur_allocated);
-  cur_allocated -= size;
+  largest_component =
+      std::max_element(sizes.begin(), sizes.end()) - sizes.begin();
 }
 
-template <class T> struct tracking_allocator {
-  using value_type = T;
-
-  memory_statistics *stats;
-  std::allocator<T> base;
-
-  tracking_allocator(memory_statistics *stats) : stats{stats} {}
-  tracking_allocator(const tracking_allocator &other) : stats{other.stats} {}
-  template <class U>
-  tracking_allocator(const tracking_allocator<U> &other) : stats{other.stats} {}
+osm_graph::index_t osm_graph::nn_query(glm::dvec2 pos) const {
+  auto out_index = static_cast<std::size_t>(-1);
+  double dummy;
+  nn_tree.knnSearch(&pos[0], 1, &out_index, &dummy);
+  return out_index < snap.indices.size() ? snap.indices[out_index] : out_index;
+}
 
-  [[nodiscard]] T *allocate(std::size_t n, const void *hint = 0) {
-    auto ptr = base.allocate(n);
-    stats->alloc(n * sizeof(T));
-    return ptr;
+search_control::search_control(std::stop_token token,
+                               const search_limits &limits,
+                               const memory_statistics *memory)
+    : token{std::move(token)}, limits{limits}, memory{memory} {
+  if (limits.max_time != std::chrono::steady_clock::duration::max()) {
+    deadline = std::chrono::steady_clock::now() + limits.max_time;
+  } else {
+    deadline = std::chrono::steady_clock::time_point::max();
   }
+}
 
-  void deallocate(T *p, std::size_t n) {
-    base.deallocate(p, n);
-    stats->free(n * sizeof(T));
+bool search_control::poll() {
+  if (token.stop_requested() || expanded > limits.max_expanded ||
+      over_memory() ||
+      (deadline != std::chrono::steady_clock::time_point::max() &&
+       std::chrono::steady_clock::now() >= deadline)) {
+    is_stopped = true;
+    next_poll = expanded;
+    return true;
   }
-};
-
-template <class T> using pf_vector = std::vector<T, tracking_allocator<T>>;
-
-template <class K, class V>
-using pf_map =
-    std::map<K, V, std::less<K>,
-             tracking_allocator<typename std::map<K, V>::value_type>>;
-
-template <class K>
-using pf_set = std::set<K, std::less<K>,
-                        tracking_allocator<typename std::set<K>::value_type>>;
-
-template <class T> using pf_deque = std::deque<T, tracking_allocator<T>>;
+  next_poll = expanded + 1 +
+              std::min(std::max(limits.poll_interval, std::size_t{1}) - 1,
+                       limits.max_expanded - expanded);
+  return false;
+}
 
-inline void construct_path(pathfind_result &result, std::stop_token token,
-                           const auto &parent, const auto &graph, auto start,
-                           auto end) {
+inline void construct_path(pathfind_result &result, const auto &parent,
+                           const auto &graph, auto start, auto end) {
   result.distance = 0;
   result.path.push_back(end);
 
   if (start != end) {
     auto u = end;
     do {
-      if (token.stop_requested()) {
-        result.distance = NAN;
-        result.path.clear();
-        return;
-      }
       auto parent_u = parent.at(u);
-      result.distance += spherical_distance(graph.nodes[u].location,
-                                            graph.nodes[parent_u].location);
+      result.distance +=
+          graph.nodes[parent_u].adj[graph.find_arc(parent_u, u)].first;
       u = parent_u;
       result.path.push_back(u);
     } while (u != start);
   }
 };
 
-pathfind_result dfs(std::stop_token token, const osm_graph &graph, id_t start,
-                    id_t end) {
+search_task dfs_steps(std::stop_token token, const osm_graph &graph,
+                      id_t start, id_t end, search_limits limits) {
   pathfind_result result;
   using index_t = osm_graph::index_t;
+  search_control control{token, limits, &result.mem_stat};
+  if (!graph.may_reach(start, end)) {
+    co_return result;
+  }
 
-  pf_vector<std::pair<index_t, std::size_t>> stack{&result.mem_stat};
-  pf_set<index_t> visited{&result.mem_stat};
-
-  stack.emplace_back(start, 0);
-  visited.insert(start);
-
-  while (!stack.empty() && !token.stop_requested()) {
-    auto &back = stack.back();
-    auto cur_node = back.first;
-    auto index = back.second;
-
-    const auto &adj = graph.nodes[back.first].adj;
-    if (cur_node == end) {
-      result.distance = 0.0;
-      for (const auto &[i, _] : stack) {
-        if (token.stop_requested()) {
-          result.distance = NAN;
-          result.path.clear();
-          goto end;
-        }
-
-        if (!result.path.empty()) {
-          result.distance +=
-              spherical_distance(graph.nodes[result.path.back()].location,
-                                 graph.nodes[i].location);
+  struct frame {
+    index_t node;
+    // arcs of `node` before this one were looked at already
+    std::uint32_t next_arc;
+  };
+  pf_vector<frame> stack{&result.mem_stat};
+  // marked on push, so every node enters the stack at most once
+  pf_vector<bool> visited(graph.nodes.size(), false, &result.mem_stat);
+
+  stack.push_back({static_cast<index_t>(start), 0});
+  visited[start] = true;
+  result.counters.push(stack.size());
+
+  while (!stack.empty() && !control.expand()) {
+    co_yield search_step{};
+    auto &top = stack.back();
+    if (top.next_arc == 0) {
+      result.counters.settle();
+      control.settle(top.node);
+      if (top.node == end) {
+        // the stack is the path, every frame but the last points past the
+        // arc it was left by
+        result.distance = 0.0;
+        result.path.push_back(top.node);
+        for (auto i = stack.size() - 1; i > 0; --i) {
+          const auto &prev = stack[i - 1];
+          const auto &adj = graph.nodes[prev.node].adj;
+          result.distance += adj[prev.next_arc - 1].first;
+          result.path.push_back(prev.node);
         }
-
-        result.path.push_back(i);
+        break;
       }
-      break;
     }
 
-    // skip visited nodes
-    while (index < adj.size() && visited.contains(adj[index].second)) {
-      ++index;
-      if (token.stop_requested()) {
-        goto end;
-      }
+    const auto &adj = graph.nodes[top.node].adj;
+    while (top.next_arc < adj.size() && visited[adj[top.next_arc].second]) {
+      result.counters.relax();
+      ++top.next_arc;
     }
-
-    if (index >= adj.size()) {
+    if (top.next_arc == adj.size()) {
       stack.pop_back();
-    } else {
-      ++back.second;
-      visited.insert(cur_node);
-      // note: emplace_back must be done after all modifications to `back`
-      stack.emplace_back(adj[index].second, 0);
+      result.counters.pop();
+      continue;
     }
+
+    result.counters.relax();
+    auto next_node = adj[top.next_arc++].second;
+    visited[next_node] = true;
+    // note: `top` is invalidated here
+    stack.push_back({next_node, 0});
+    result.counters.push(stack.size());
   }
 
-end:
-  return result;
+  result.stopped = control.stopped();
+  co_return result;
 }
 
-pathfind_result bfs(std::stop_token token, const osm_graph &graph, id_t start,
-                    id_t end) {
+search_task bfs_steps(std::stop_token token, const osm_graph &graph,
+                      id_t start, id_t end, search_limits limits) {
   pathfind_result result;
   using index_t = osm_graph::index_t;
+  search_control control{token, limits, &result.mem_stat};
+  if (!graph.may_reach(start, end)) {
+    co_return result;
+  }
 
   pf_deque<index_t> queue{&result.mem_stat};
   pf_map<index_t, index_t> parent{&result.mem_stat};
 
   queue.push_back(start);
   parent[start] = static_cast<osm_graph::index_t>(-1);
+  result.counters.push(queue.size());
 
-  while (!queue.empty() && !token.stop_requested()) {
+  while (!queue.empty() && !control.expand()) {
+    co_yield search_step{};
     auto cur_node = queue.front();
     queue.pop_front();
+    result.counters.pop();
+    result.counters.settle();
+    control.settle(cur_node);
 
     if (cur_node == end) {
-      construct_path(result, token, parent, graph, start, end);
+      construct_path(result, parent, graph, start, end);
       break;
     }
 
     for (const auto [_, next_node] : graph.nodes[cur_node].adj) {
-      if (token.stop_requested()) {
-        return result;
-      }
-
+      result.counters.relax();
       if (!parent.contains(next_node)) {
         parent.emplace(next_node, cur_node);
         queue.push_back(next_node);
+        result.counters.push(queue.size());
       }
     }
   }
 
   result.finish_time = std::chrono::high_resolution_clock::now();
-  return result;
+  result.stopped = control.stopped();
+  co_return result;
 }
 
 template <class K, class V> struct pf_priority_queue {
@@ -326,13 +536,18 @@ template <class K, class V> struct pf_priority_queue {
 auto heuristic(const osm_graph &graph, osm_graph::index_t start,
                osm_graph::index_t end) {
   return spherical_distance(graph.nodes[end].location,
-                            graph.nodes[start].location);
+                            graph.nodes[start].location) /
+         graph.max_speed;
 }
 
-pathfind_result befs(std::stop_token token, const osm_graph &graph, id_t start,
-                     id_t end) {
+search_task befs_steps(std::stop_token token, const osm_graph &graph,
+                       id_t start, id_t end, search_limits limits) {
   pathfind_result result;
   using index_t = osm_graph::index_t;
+  search_control control{token, limits, &result.mem_stat};
+  if (!graph.may_reach(start, end)) {
+    co_return result;
+  }
 
   pf_priority_queue<index_t, double> queue{&result.mem_stat};
   pf_map<index_t, index_t> parent{&result.mem_stat};
@@ -340,31 +555,46 @@ pathfind_result befs(std::stop_token token, const osm_graph &graph, id_t start,
 
   queue.insert(start, dist_so_far[start] = 0.0);
   parent[start] = static_cast<index_t>(-1);
+  result.counters.push(queue.heap.size());
 
   for (std::optional<std::pair<index_t, double>> cur;
-       cur = queue.extract_min(), cur.has_value() && !token.stop_requested();) {
+       cur = queue.extract_min(), cur.has_value() && !control.expand();) {
+    co_yield search_step{};
     auto [cur_node, est_dist] = *cur;
+    result.counters.pop();
+    result.counters.settle();
+    control.settle(cur_node);
     if (cur_node == end) {
-      construct_path(result, token, parent, graph, start, end);
+      construct_path(result, parent, graph, start, end);
       break;
     }
 
     for (const auto [_, next_node] : graph.nodes[cur_node].adj) {
+      result.counters.relax();
       if (!parent.contains(next_node)) {
         parent[next_node] = cur_node;
         queue.insert(next_node, heuristic(graph, next_node, end));
+        result.counters.push(queue.heap.size());
       }
     }
   }
 
-end:
-  return result;
+  result.stopped = control.stopped();
+  co_return result;
 }
 
-pathfind_result heuristic_search(std::stop_token token, const osm_graph &graph,
-                                 id_t start, id_t end, auto heuristic) {
+// `allowed(tail, k)` says whether the search may take the k-th arc of `tail`.
+// gives up once no estimate is below `bound`.
+search_task heuristic_search(
+    std::stop_token token, const osm_graph &graph, id_t start, id_t end,
+    search_limits limits, auto heuristic, auto allowed,
+    double bound = std::numeric_limits<double>::infinity()) {
   pathfind_result result;
   using index_t = osm_graph::index_t;
+  search_control control{token, limits, &result.mem_stat};
+  if (!graph.may_reach(start, end)) {
+    co_return result;
+  }
 
   pf_priority_queue<index_t, double> queue{&result.mem_stat};
   pf_map<index_t, index_t> parent{&result.mem_stat};
@@ -373,44 +603,570 @@ pathfind_result heuristic_search(std::stop_token token, const osm_graph &graph,
   queue.insert(start, heuristic(graph, start, end));
   parent[start] = static_cast<index_t>(-1);
   dist_so_far[start] = 0.0;
+  result.counters.push(queue.heap.size());
 
   for (std::optional<std::pair<index_t, double>> cur;
-       cur = queue.extract_min(), cur.has_value() && !token.stop_requested();) {
+       cur = queue.extract_min(), cur.has_value() && !control.expand();) {
     auto [cur_node, est_dist] = *cur;
+    if (est_dist >= bound) {
+      break;
+    }
+    co_yield search_step{};
+    result.counters.pop();
+    result.counters.settle();
+    control.settle(cur_node);
     if (cur_node == end) {
-      construct_path(result, token, parent, graph, start, end);
+      construct_path(result, parent, graph, start, end);
       break;
     }
 
-    for (const auto [weight, next_node] : graph.nodes[cur_node].adj) {
-      if (token.stop_requested()) {
-        goto end;
+    const auto &adj = graph.nodes[cur_node].adj;
+    for (std::size_t k = 0; k < adj.size(); ++k) {
+      if (!allowed(cur_node, k)) {
+        continue;
       }
-
+      const auto [weight, next_node] = adj[k];
+      result.counters.relax();
       auto dist_so_far_next_node = dist_so_far[cur_node] + weight;
-      if (!dist_so_far.contains(next_node) ||
-          dist_so_far[next_node] > dist_so_far_next_node) {
+      auto known = dist_so_far.contains(next_node);
+      if (!known || dist_so_far[next_node] > dist_so_far_next_node) {
         dist_so_far[next_node] = dist_so_far_next_node;
         parent[next_node] = cur_node;
         queue.decrease_key(next_node, dist_so_far_next_node +
                                           heuristic(graph, next_node, end));
+        if (known) {
+          result.counters.decrease_key();
+        } else {
+          result.counters.push(queue.heap.size());
+        }
       }
     }
   }
 
-end:
-  return result;
+  result.stopped = control.stopped();
+  co_return result;
+}
+
+constexpr auto every_arc = [](auto &&...) { return true; };
+
+search_task ucs_steps(std::stop_token token, const osm_graph &graph,
+                      id_t start, id_t end, search_limits limits) {
+  return heuristic_search(
+      token, graph, start, end, limits, [](auto &&...) { return 0; },
+      every_arc);
+}
+
+search_task a_star_steps(std::stop_token token, const osm_graph &graph,
+                         id_t start, id_t end, search_limits limits) {
+  return heuristic_search(token, graph, start, end, limits, heuristic,
+                          every_arc);
+}
+
+search_task arc_flags_steps(std::stop_token token, const arc_flags &flags,
+                            id_t start, id_t end, search_limits limits) {
+  auto region = flags.region(end);
+  return heuristic_search(token, flags.graph, start, end, limits, heuristic,
+                          [&flags, region](auto tail, std::size_t k) {
+                            return flags.allowed(tail, k, region);
+                          });
+}
+
+// `nodes` is a path from `start` to `end`
+inline void construct_path(pathfind_result &result, const auto &nodes,
+                           const auto &graph) {
+  result.distance = 0;
+  result.path.push_back(nodes.back());
+  for (auto i = nodes.size() - 1; i > 0; --i) {
+    const auto &adj = graph.nodes[nodes[i - 1]].adj;
+    result.distance += adj[graph.find_arc(nodes[i - 1], nodes[i])].first;
+    result.path.push_back(nodes[i - 1]);
+  }
+}
+
+search_task ida_star_steps(std::stop_token token, const osm_graph &graph,
+                           id_t start, id_t end, search_limits limits) {
+  pathfind_result result;
+  using index_t = osm_graph::index_t;
+  constexpr auto inf = std::numeric_limits<double>::infinity();
+  search_control control{token, limits, &result.mem_stat};
+  if (!graph.may_reach(start, end)) {
+    co_return result;
+  }
+
+  struct frame {
+    index_t node;
+    double dist;
+    std::size_t next_arc;
+  };
+  pf_vector<frame> stack{&result.mem_stat};
+  pf_set<index_t> on_stack{&result.mem_stat};
+  // shortest distance each node was reached with and in which iteration. it
+  // stops taking new nodes at half the memory limit, the rest is left for the
+  // stack, and only ever prunes paths that cannot be shorter
+  pf_map<index_t, std::pair<double, std::size_t>> seen{&result.mem_stat};
+  const auto seen_budget = limits.max_memory / 2;
+  pf_vector<index_t> best_path{&result.mem_stat};
+  auto best = inf;
+  // what the containers hold, counted here rather than by the allocator,
+  // which may be compiled out. a frame comes with its entry in `on_stack`,
+  // tree entries with their node pointers.
+  constexpr std::size_t frame_size =
+      sizeof(frame) + sizeof(index_t) + 4 * sizeof(void *);
+  constexpr std::size_t seen_entry_size =
+      sizeof(std::pair<const index_t, std::pair<double, std::size_t>>) +
+      4 * sizeof(void *);
+  auto memory = [&] {
+    return stack.size() * frame_size + seen.size() * seen_entry_size +
+           best_path.size() * sizeof(index_t);
+  };
+
+  const auto first_estimate = heuristic(graph, start, end);
+  auto threshold = first_estimate;
+  for (std::size_t iteration = 0;; ++iteration) {
+    // lowest estimate cut off by this iteration's threshold
+    auto next_threshold = inf;
+    if (memory() + frame_size > limits.max_memory) {
+      control.stop();
+      break;
+    }
+    stack.push_back({static_cast<index_t>(start), 0.0, 0});
+    on_stack.insert(start);
+    result.counters.push(stack.size());
+
+    while (!stack.empty()) {
+      auto &top = stack.back();
+      const auto &adj = graph.nodes[top.node].adj;
+      if (top.next_arc == 0) {
+        if (control.expand()) {
+          break;
+        }
+        co_yield search_step{};
+        result.counters.settle();
+        control.settle(top.node);
+        if (top.node == end) {
+          // the stack replaces the previous best path
+          if (memory() - best_path.size() * sizeof(index_t) +
+                  stack.size() * sizeof(index_t) >
+              limits.max_memory) {
+            control.stop();
+            break;
+          }
+          // only paths shorter than `best` are followed
+          best = top.dist;
+          best_path.clear();
+          for (const auto &f : stack) {
+            best_path.push_back(f.node);
+          }
+          top.next_arc = adj.size();
+        }
+      }
+
+      if (top.next_arc == adj.size()) {
+        on_stack.erase(top.node);
+        stack.pop_back();
+        result.counters.pop();
+        continue;
+      }
+
+      const auto [weight, next] = adj[top.next_arc++];
+      result.counters.relax();
+      auto dist = top.dist + weight;
+      auto estimate = dist + heuristic(graph, next, end);
+      if (estimate > threshold) {
+        next_threshold = std::min(next_threshold, estimate);
+        continue;
+      }
+      if (estimate >= best || on_stack.contains(next)) {
+        continue;
+      }
+      if (auto it = seen.find(next); it != seen.end()) {
+        auto [seen_dist, seen_iteration] = it->second;
+        if (seen_dist < dist ||
+            (seen_dist == dist && seen_iteration == iteration)) {
+          continue;
+        }
+        it->second = {dist, iteration};
+      } else if ((seen.size() + 1) * seen_entry_size <= seen_budget) {
+        seen.emplace(next, std::pair{dist, iteration});
+      }
+      if (memory() + frame_size > limits.max_memory) {
+        control.stop();
+        break;
+      }
+      // note: `top` is invalidated here
+      stack.push_back({next, dist, 0});
+      on_stack.insert(next);
+      result.counters.push(stack.size());
+    }
+
+    // every path estimated below `best` was within the threshold
+    if (control.stopped() || best != inf || next_threshold == inf) {
+      break;
+    }
+    // at least double the slack over the first estimate, so that iterations
+    // grow geometrically instead of admitting one estimate at a time
+    threshold = std::max(next_threshold,
+                         first_estimate + 2.0 * (threshold - first_estimate));
+  }
+
+  if (!control.stopped() && best != inf) {
+    construct_path(result, best_path, graph);
+  }
+  result.stopped = control.stopped();
+  co_return result;
+}
+
+search_task sma_star_steps(std::stop_token token, const osm_graph &graph,
+                           id_t start, id_t end, search_limits limits) {
+  pathfind_result result;
+  using index_t = osm_graph::index_t;
+  constexpr auto inf = std::numeric_limits<double>::infinity();
+  constexpr auto no_parent = static_cast<index_t>(-1);
+  search_control control{token, limits, &result.mem_stat};
+  if (!graph.may_reach(start, end)) {
+    co_return result;
+  }
+
+  struct tree_node {
+    double dist;
+    // key in `open` while queued
+    double estimate;
+    index_t parent;
+    std::size_t children = 0;
+    // lowest estimate of the successors pruned since the last expansion
+    double forgotten = inf;
+    bool queued = false;
+  };
+  pf_map<index_t, tree_node> tree{&result.mem_stat};
+  // (estimate, node) of the nodes waiting to be expanded: leaves, nodes that
+  // were reached by a shorter path, and parents of pruned nodes that have to
+  // be expanded again to regenerate them
+  pf_set<std::pair<double, index_t>> open{&result.mem_stat};
+  // the queued nodes without children, all but the root: those `prune` may
+  // drop, in the same order
+  pf_set<std::pair<double, index_t>> leaves{&result.mem_stat};
+  // what one more node costs in all three containers, tree pointers included.
+  // the tree is held to the limit by this count rather than by the allocator,
+  // which may be compiled out.
+  constexpr std::size_t node_size =
+      sizeof(std::pair<const index_t, tree_node>) +
+      2 * sizeof(std::pair<double, index_t>) + 12 * sizeof(void *);
+
+  auto enqueue = [&](index_t node, double estimate) {
+    auto &n = tree.at(node);
+    if (n.queued) {
+      open.erase({n.estimate, node});
+      leaves.erase({n.estimate, node});
+    }
+    n.estimate = estimate;
+    n.queued = true;
+    open.emplace(estimate, node);
+    if (n.children == 0 && n.parent != no_parent) {
+      leaves.emplace(estimate, node);
+    }
+  };
+  // a parent that lost its last child is a leaf again, estimated by the best
+  // successor it forgot unless it is queued already
+  auto detach = [&](index_t parent) {
+    auto &p = tree.at(parent);
+    if (--p.children == 0) {
+      enqueue(parent, p.queued ? p.estimate : p.forgotten);
+    }
+  };
+  // drops the leaf with the highest estimate that is not a child of
+  // `expanding`, false if there is none. only those children are skipped.
+  auto prune = [&](index_t expanding) {
+    for (auto it = leaves.rbegin(); it != leaves.rend(); ++it) {
+      auto [estimate, leaf] = *it;
+      auto parent = tree.at(leaf).parent;
+      if (parent == expanding) {
+        continue;
+      }
+      leaves.erase(std::next(it).base());
+      open.erase({estimate, leaf});
+      tree.erase(leaf);
+      // the parent is queued again right away: the pruned subtree may hold a
+      // better path than any node still in memory
+      auto &p = tree.at(parent);
+      p.forgotten = std::min(p.forgotten, estimate);
+      --p.children;
+      enqueue(parent, std::min(p.queued ? p.estimate : inf, p.forgotten));
+      return true;
+    }
+    return false;
+  };
+
+  auto first_estimate = heuristic(graph, start, end);
+  tree.emplace(start, tree_node{0.0, first_estimate, no_parent});
+  enqueue(start, first_estimate);
+  result.counters.push(open.size());
+
+  while (!open.empty() && !control.expand()) {
+    co_yield search_step{};
+    auto [estimate, cur_node] = *open.begin();
+    if (estimate == inf) {
+      break;
+    }
+    open.erase(open.begin());
+    leaves.erase({estimate, cur_node});
+    tree.at(cur_node).queued = false;
+    result.counters.pop();
+    result.counters.settle();
+    control.settle(cur_node);
+    if (cur_node == end) {
+      pf_vector<index_t> path{&result.mem_stat};
+      for (auto node = end; node != no_parent; node = tree.at(node).parent) {
+        path.push_back(node);
+      }
+      std::reverse(path.begin(), path.end());
+      construct_path(result, path, graph);
+      break;
+    }
+
+    const auto &adj = graph.nodes[cur_node].adj;
+    auto fits = [&](std::size_t new_nodes) {
+      return (tree.size() + new_nodes) * node_size <= limits.max_memory;
+    };
+    // make room for every successor before adding any
+    while (!fits(adj.size()) && prune(cur_node)) {
+    }
+    // nothing left to prune: stop rather than go over the limit, unless the
+    // successors that are not in memory yet still fit
+    if (!fits(adj.size()) &&
+        !fits(std::count_if(adj.begin(), adj.end(), [&](const auto &arc) {
+          return !tree.contains(arc.second);
+        }))) {
+      control.stop();
+      break;
+    }
+
+    // successors still in memory are skipped, forgotten ones come back
+    auto &cur = tree.at(cur_node);
+    cur.forgotten = inf;
+    for (const auto &[weight, next_node] : adj) {
+      result.counters.relax();
+      auto dist = cur.dist + weight;
+      auto next_estimate = dist + heuristic(graph, next_node, end);
+      auto it = tree.find(next_node);
+      if (it == tree.end()) {
+        tree.emplace(next_node, tree_node{dist, next_estimate, cur_node});
+        enqueue(next_node, next_estimate);
+        ++cur.children;
+        result.counters.push(open.size());
+      } else if (dist < it->second.dist) {
+        // a shorter path to a node in memory: move it with its subtree, the
+        // subtree is relabeled when the node is expanded again
+        auto &next = it->second;
+        if (next.parent != cur_node) {
+          detach(next.parent);
+          ++cur.children;
+        }
+        next.dist = dist;
+        next.parent = cur_node;
+        enqueue(next_node, next_estimate);
+        result.counters.decrease_key();
+      }
+    }
+    if (cur.children == 0) {
+      // nothing new behind it, first in line to be pruned
+      enqueue(cur_node, inf);
+    }
+  }
+
+  result.stopped = control.stopped();
+  co_return result;
+}
+
+pathfind_result dfs(std::stop_token token, const osm_graph &graph, id_t start,
+                    id_t end, const search_limits &limits) {
+  return dfs_steps(token, graph, start, end, limits).run();
+}
+
+pathfind_result bfs(std::stop_token token, const osm_graph &graph, id_t start,
+                    id_t end, const search_limits &limits) {
+  return bfs_steps(token, graph, start, end, limits).run();
+}
+
+pathfind_result befs(std::stop_token token, const osm_graph &graph, id_t start,
+                     id_t end, const search_limits &limits) {
+  return befs_steps(token, graph, start, end, limits).run();
 }
 
 pathfind_result ucs(std::stop_token token, const osm_graph &graph, id_t start,
-                    id_t end) {
-  return heuristic_search(token, graph, start, end,
-                          [](auto &&...) { return 0; });
+                    id_t end, const search_limits &limits) {
+  return ucs_steps(token, graph, start, end, limits).run();
+}
+
+pathfind_result ucs(std::stop_token token, const osm_graph &graph, id_t start,
+                    id_t end, const search_limits &limits,
+                    shortest_path_tree &workspace) {
+  pathfind_result result;
+  if (!graph.may_reach(start, end)) {
+    return result;
+  }
+  grow_shortest_path_tree(token, graph, start,
+                          {.target = static_cast<osm_graph::index_t>(end),
+                           .limits = limits},
+                          workspace);
+  result.stopped = !workspace.complete;
+  result.counters = workspace.counters;
+  // the part of the tree the search used, as if allocated for the query: the
+  // labels it touched with their entries in `touched` and the queue (lazy
+  // duplicates aside), and the settled list
+  using index_t = osm_graph::index_t;
+  const auto bytes =
+      workspace.touched.size() *
+          (sizeof(double) + 2 * sizeof(index_t) +
+           sizeof(std::pair<double, index_t>)) +
+      workspace.settled.size() * sizeof(index_t);
+  result.mem_stat.alloc(bytes);
+  result.mem_stat.free(bytes);
+  if (workspace.complete && workspace.reached(end)) {
+    construct_path(result, workspace.parent, graph, start, end);
+  }
+  return result;
 }
 
 pathfind_result a_star(std::stop_token token, const osm_graph &graph,
-                       id_t start, id_t end) {
-  return heuristic_search(token, graph, start, end, heuristic);
+                       id_t start, id_t end, const search_limits &limits) {
+  return a_star_steps(token, graph, start, end, limits).run();
+}
+
+pathfind_result arc_flags_search(std::stop_token token, const arc_flags &flags,
+                                 id_t start, id_t end,
+                                 const search_limits &limits) {
+  return arc_flags_steps(token, flags, start, end, limits).run();
+}
+
+pathfind_result guided_search(std::stop_token token, const osm_graph &graph,
+                              id_t start, id_t end,
+                              const search_limits &limits,
+                              const std::vector<double> &to_end,
+                              const arc_filter &allowed, double bound) {
+  return heuristic_search(
+             token, graph, start, end, limits,
+             [&](const auto &, auto node, auto) { return to_end[node]; },
+             allowed, bound)
+      .run();
+}
+
+pathfind_result ida_star(std::stop_token token, const osm_graph &graph,
+                         id_t start, id_t end, const search_limits &limits) {
+  return ida_star_steps(token, graph, start, end, limits).run();
+}
+
+pathfind_result sma_star(std::stop_token token, const osm_graph &graph,
+                         id_t start, id_t end, const search_limits &limits) {
+  return sma_star_steps(token, graph, start, end, limits).run();
+}
+
+void shortest_path_tree::reset(std::size_t num_nodes) {
+  if (distance.size() != num_nodes) {
+    distance.assign(num_nodes, unreached);
+    parent.assign(num_nodes, no_parent);
+  } else {
+    for (auto node : touched) {
+      distance[node] = unreached;
+      parent[node] = no_parent;
+    }
+  }
+  settled.clear();
+  touched.clear();
+  queue.clear();
+  complete = false;
+  counters = {};
+}
+
+void grow_shortest_path_tree(std::stop_token token, const osm_graph &graph,
+                             id_t root, const tree_search_options &options,
+                             shortest_path_tree &tree,
+                             const tree_progress_fn &progress,
+                             std::size_t progress_interval) {
+  using index_t = osm_graph::index_t;
+  search_control control{token, options.limits};
+  tree.reset(graph.nodes.size());
+  tree.source = root;
+  tree.budget = options.budget;
+  auto &budget = tree.budget;
+
+  // lazy deletion binary heap: stale entries are skipped when popped, which is
+  // cheaper than keeping an index map for decrease-key
+  auto &queue = tree.queue;
+  auto push = [&](double dist, index_t node) {
+    queue.emplace_back(dist, node);
+    std::push_heap(queue.begin(), queue.end(), std::greater<>{});
+    tree.counters.push(queue.size());
+  };
+
+  tree.distance[root] = 0.0;
+  tree.touched.push_back(root);
+  push(0.0, root);
+
+  while (!queue.empty()) {
+    std::pop_heap(queue.begin(), queue.end(), std::greater<>{});
+    auto [dist, cur_node] = queue.back();
+    queue.pop_back();
+    tree.counters.pop();
+    if (dist > tree.distance[cur_node]) {
+      continue;
+    }
+    if (dist > budget) {
+      // the budget shrank after reaching the target, drop the labels that
+      // were set before and are not final
+      for (auto node : tree.touched) {
+        if (tree.distance[node] > budget) {
+          tree.distance[node] = shortest_path_tree::unreached;
+          tree.parent[node] = shortest_path_tree::no_parent;
+        }
+      }
+      break;
+    }
+
+    tree.settled.push_back(cur_node);
+    tree.counters.settle();
+    control.settle(cur_node);
+    if (cur_node == options.target) {
+      budget = std::min(budget, dist * options.target_stretch);
+    }
+    if (control.expand()) {
+      return;
+    }
+    if (progress && tree.settled.size() % progress_interval == 0) {
+      progress(tree);
+    }
+
+    const auto &vertex = graph.nodes[cur_node];
+    for (const auto &[weight, next_node] :
+         options.reverse ? vertex.radj : vertex.adj) {
+      tree.counters.relax();
+      auto next_dist = dist + weight;
+      if (next_dist > budget || next_dist >= tree.distance[next_node]) {
+        continue;
+      }
+      if (tree.distance[next_node] == shortest_path_tree::unreached) {
+        tree.touched.push_back(next_node);
+      } else {
+        // the lazy heap pushes again instead
+        tree.counters.decrease_key();
+      }
+      tree.distance[next_node] = next_dist;
+      tree.parent[next_node] = cur_node;
+      push(next_dist, next_node);
+    }
+  }
+
+  tree.complete = true;
+  if (progress) {
+    progress(tree);
+  }
+}
+
+void ucs_one_to_all(std::stop_token token, const osm_graph &graph, id_t start,
+                    double budget, shortest_path_tree &tree,
+                    const tree_progress_fn &progress,
+                    std::size_t progress_interval) {
+  grow_shortest_path_tree(token, graph, start, {.budget = budget}, tree,
+                          progress, progress_interval);
 }
 
 } // namespace mapapp
@@ -1,15 +1,33 @@
 #pragma once
 
+#include "frontier_stream.hpp"
 #include "map_loader.hpp"
+#include "tracking_allocator.hpp"
+#include <algorithm>
 #include <chrono>
+#include <coroutine>
 #include <fmt/base.h>
+#include <functional>
 #include <glm/vec2.hpp>
+#include <limits>
 #include <map>
 #include <nanoflann.hpp>
+#include <optional>
 #include <osmium/osm/location.hpp>
 #include <stop_token>
+#include <utility>
+
+// per-query search counters, compiled out of the inner loops when disabled
+#ifndef MAPAPP_SEARCH_COUNTERS
+#define MAPAPP_SEARCH_COUNTERS 1
+#endif
+
 namespace mapapp {
+struct arc_flags;
+struct routing_profile;
 
+// the road network. it is never modified after construction, so any number of
+// threads may share one instance through its const members.
 struct osm_graph {
   using index_t = std::size_t;
 
@@ -18,14 +36,22 @@ struct osm_graph {
     id_t id;
     glm::vec2 position;
     std::vector<std::pair<double, index_t>> adj;
+    // incoming arcs as (weight, tail), for searches towards a target
+    std::vector<std::pair<double, index_t>> radj;
   };
 
   struct node_vector : public std::vector<node_vertex> {
     using std::vector<node_vertex>::vector;
+  };
+
+  // the nodes `nn_query` can return
+  struct snap_points {
+    const node_vector &nodes;
+    std::vector<index_t> indices = {};
 
-    size_t kdtree_get_point_count() const { return size(); }
+    size_t kdtree_get_point_count() const { return indices.size(); }
     double kdtree_get_pt(const std::size_t idx, int dim) const {
-      return at(idx).position[dim];
+      return nodes[indices[idx]].position[dim];
     }
 
     template <class BBOX> bool kdtree_get_bbox(BBOX &bb) const { return false; }
@@ -34,46 +60,372 @@ struct osm_graph {
   std::map<id_t, index_t> node_index_map;
   node_vector nodes;
 
+  // strongly connected component of each node. components are numbered in
+  // reverse topological order, so no arc leads to a component with a higher
+  // number.
+  std::vector<index_t> component;
+  index_t num_components = 0;
+  // the component with the most nodes
+  index_t largest_component = 0;
+
+  snap_points snap{nodes};
+
+  // most metres an arc covers per unit of its weight: 1 for lengths, the top
+  // speed in m/s for travel times. heuristics divide straight line distances
+  // by it.
+  double max_speed = 1.0;
+
   struct adaptor_t {};
 
   nanoflann::KDTreeSingleIndexAdaptor<
-      nanoflann::L2_Simple_Adaptor<double, decltype(nodes)>, decltype(nodes), 2,
+      nanoflann::L2_Simple_Adaptor<double, snap_points>, snap_points, 2,
       std::size_t>
       nn_tree;
 
-  osm_graph(const map_loader &map);
+  // arcs weighted by length, or by travel time with `profile`. the nodes of
+  // every highway are in the graph, in the same order for every profile.
+  // `snap_to_largest_component` leaves the nodes of every other component
+  // out of `nn_query`, so that clicks never land on an isolated fragment.
+  osm_graph(const map_loader &map, const routing_profile *profile = nullptr,
+            bool snap_to_largest_component = true);
+  // from nodes whose arcs are already filled in, in any order
+  explicit osm_graph(node_vector vertices, double max_speed = 1.0,
+                     bool snap_to_largest_component = true);
   osm_graph(const osm_graph &) = delete;
   auto operator=(const osm_graph &) = delete;
   osm_graph(osm_graph &&) = delete;
   auto operator=(osm_graph &&) = delete;
 
-  index_t nn_query(glm::dvec2 pos);
+  index_t nn_query(glm::dvec2 pos) const;
+
+  // the lightest arc `tail` -> `head`, the one searches take: its position in
+  // `nodes[tail].adj`, or the size of `adj` if there is none
+  std::size_t find_arc(index_t tail, index_t head) const {
+    const auto &adj = nodes[tail].adj;
+    return std::find_if(adj.begin(), adj.end(),
+                        [&](const auto &arc) { return arc.second == head; }) -
+           adj.begin();
+  }
+
+  // false if there is certainly no path: a path never leads to a component
+  // with a higher number. true does not promise a path unless both nodes are
+  // in the same component.
+  bool may_reach(index_t from, index_t to) const {
+    return component[from] >= component[to];
+  }
+
+private:
+  void find_components();
 };
-struct memory_statistics {
-  std::size_t total_allocated = 0;
-  std::size_t max_allocated = 0;
-  std::size_t cur_allocated = 0;
 
-  void alloc(std::size_t size);
-  void free(std::size_t size);
+// when a search gives up before it is done, on top of its stop token
+struct search_limits {
+  // measured from the start of the search
+  std::chrono::steady_clock::duration max_time =
+      std::chrono::steady_clock::duration::max();
+  std::size_t max_expanded = std::numeric_limits<std::size_t>::max();
+  // bytes held by the search's containers, as counted by its tracking
+  // allocators. checked after every expanded node, so a search may go over it
+  // by what one expansion allocates. not enforced without MAPAPP_MEMORY_STATS,
+  // except by IDA* and SMA*, which count their own entries against it.
+  std::size_t max_memory = std::numeric_limits<std::size_t>::max();
+  // the token, the clock and `max_expanded` are only looked at every this many
+  // expanded nodes, so inner loops never touch an atomic
+  std::size_t poll_interval = 1024;
+};
+
+// counts the nodes a search expands and decides when it has to stop. also
+// publishes settled nodes if a `frontier_stream::scope` is live on the thread.
+class search_control {
+public:
+  // `memory` is what `limits.max_memory` is checked against
+  search_control(std::stop_token token, const search_limits &limits,
+                 const memory_statistics *memory = nullptr);
+  search_control(const search_control &) = delete;
+  auto operator=(const search_control &) = delete;
+  ~search_control() {
+    if (frontier) {
+      frontier->flush();
+    }
+  }
+
+  // call once per expanded node, true once the search has to stop
+  bool expand() {
+    return (++expanded >= next_poll || over_memory()) && poll();
+  }
+  bool stopped() const { return is_stopped; }
+  // for a limit the search checks itself
+  void stop() { is_stopped = true; }
+  void settle(std::size_t node) {
+    if (frontier) [[unlikely]] {
+      frontier->publish(node);
+    }
+  }
+
+private:
+  std::stop_token token;
+  search_limits limits;
+  const memory_statistics *memory;
+  frontier_stream *frontier = current_frontier_stream();
+  std::chrono::steady_clock::time_point deadline;
+  std::size_t expanded = 0, next_poll = 1;
+  bool is_stopped = false;
+
+  bool over_memory() const {
+    return memory != nullptr && memory->cur_allocated > limits.max_memory;
+  }
+  bool poll();
+};
+
+// what a search did, for tuning. all zero when counters are compiled out.
+struct search_counters {
+  static constexpr bool enabled = MAPAPP_SEARCH_COUNTERS;
+
+  std::size_t settled = 0;
+  // arcs looked at from settled nodes
+  std::size_t relaxed = 0;
+  std::size_t pushes = 0, pops = 0;
+  // improved labels of nodes already in the frontier
+  std::size_t decrease_keys = 0;
+  std::size_t max_frontier = 0;
+
+  void settle() {
+    if constexpr (enabled) {
+      ++settled;
+    }
+  }
+  void relax() {
+    if constexpr (enabled) {
+      ++relaxed;
+    }
+  }
+  // `frontier` is the size after the push
+  void push(std::size_t frontier) {
+    if constexpr (enabled) {
+      ++pushes;
+      max_frontier = std::max(max_frontier, frontier);
+    }
+  }
+  void pop() {
+    if constexpr (enabled) {
+      ++pops;
+    }
+  }
+  void decrease_key() {
+    if constexpr (enabled) {
+      ++decrease_keys;
+    }
+  }
 };
 
 struct pathfind_result {
+  using time_point = std::chrono::high_resolution_clock::time_point;
+
+  // node indices from `end` back to `start`, empty if there is no path
   std::vector<osm_graph::index_t> path;
   double distance = NAN;
-  std::chrono::high_resolution_clock::time_point finish_time;
+  // filled in by whoever runs the query: when it was queued, when a worker
+  // picked it up and when it returned
+  time_point submit_time, start_time, finish_time;
   memory_statistics mem_stat;
+  search_counters counters;
+  // cancelled or out of limits before the search finished
+  bool stopped = false;
+
+  auto queue_delay() const { return start_time - submit_time; }
+  auto execution_time() const { return finish_time - start_time; }
 
   // check if path found
   operator bool() { return !std::isnan(distance); }
 };
 
+// yielded by a search coroutine once per expanded node
+struct search_step {};
+
+// a search running as a coroutine on whichever thread advances it. it is
+// suspended every `step` expanded nodes, so many searches can take turns on
+// one thread; run to completion it gives the same result as the function.
+class search_task {
+public:
+  struct promise_type {
+    std::size_t step = std::numeric_limits<std::size_t>::max();
+    std::size_t since_resume = 0;
+    std::optional<pathfind_result> result;
+
+    struct step_awaiter {
+      bool ready;
+      bool await_ready() const noexcept { return ready; }
+      void await_suspend(std::coroutine_handle<>) const noexcept {}
+      void await_resume() const noexcept {}
+    };
+
+    search_task get_return_object() {
+      return search_task{
+          std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    // nothing runs until the first `advance`
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    step_awaiter yield_value(search_step) noexcept {
+      if (++since_resume < step) {
+        return {true};
+      }
+      since_resume = 0;
+      return {false};
+    }
+    void return_value(pathfind_result r) { result = std::move(r); }
+    void unhandled_exception() { throw; }
+  };
+
+  search_task(search_task &&other) noexcept
+      : handle{std::exchange(other.handle, {})} {}
+  search_task &operator=(search_task &&other) noexcept {
+    std::swap(handle, other.handle);
+    return *this;
+  }
+  ~search_task() {
+    if (handle) {
+      handle.destroy();
+    }
+  }
+
+  // expanded nodes per `advance`, may change between calls
+  void set_step(std::size_t step) {
+    handle.promise().step = std::max(step, std::size_t{1});
+  }
+  // true once the search has returned
+  bool done() const { return handle.done(); }
+  // runs the search for up to `step` more expanded nodes, true once it is done
+  bool advance() {
+    if (!handle.done()) {
+      handle.resume();
+    }
+    return handle.done();
+  }
+  // only valid once `done`
+  pathfind_result &result() { return *handle.promise().result; }
+  // runs what is left of the search without suspending
+  pathfind_result run() {
+    set_step(std::numeric_limits<std::size_t>::max());
+    advance();
+    return std::move(result());
+  }
+
+private:
+  explicit search_task(std::coroutine_handle<promise_type> handle)
+      : handle{handle} {}
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+// dense one-to-all labels. the arrays are sized to the whole graph once and
+// then reused: resetting only touches the nodes reached by the previous search,
+// so repeated searches cost time linear in the reachable subgraph
+struct shortest_path_tree {
+  static constexpr auto unreached = std::numeric_limits<double>::infinity();
+  static constexpr auto no_parent = static_cast<osm_graph::index_t>(-1);
+
+  osm_graph::index_t source = no_parent;
+  double budget = unreached;
+  std::vector<double> distance;
+  std::vector<osm_graph::index_t> parent;
+  // nodes in the order they were settled, every prefix is a valid partial tree
+  std::vector<osm_graph::index_t> settled;
+  std::vector<osm_graph::index_t> touched;
+  std::vector<std::pair<double, osm_graph::index_t>> queue;
+  bool complete = false;
+  search_counters counters;
+
+  void reset(std::size_t num_nodes);
+  bool reached(osm_graph::index_t node) const {
+    return distance[node] != unreached;
+  }
+  // labels of settled nodes up to this distance are final
+  double radius() const {
+    return settled.empty() ? 0.0 : distance[settled.back()];
+  }
+};
+
+// called from the search thread every `progress_interval` settled nodes
+using tree_progress_fn = std::function<void(const shortest_path_tree &)>;
+
+struct tree_search_options {
+  double budget = shortest_path_tree::unreached;
+  // once `target` is settled the budget shrinks to `target_stretch` times its
+  // distance
+  osm_graph::index_t target = shortest_path_tree::no_parent;
+  double target_stretch = 1.0;
+  // follow arcs backwards: labels are distances *to* the root and `parent`
+  // is the next node towards it
+  bool reverse = false;
+  search_limits limits = {};
+};
+
+void grow_shortest_path_tree(std::stop_token token, const osm_graph &graph,
+                             id_t root, const tree_search_options &options,
+                             shortest_path_tree &tree,
+                             const tree_progress_fn &progress = {},
+                             std::size_t progress_interval = 4096);
+
+// uniform cost search without a target: labels every node whose distance from
+// `start` is at most `budget`
+void ucs_one_to_all(std::stop_token token, const osm_graph &graph, id_t start,
+                    double budget, shortest_path_tree &tree,
+                    const tree_progress_fn &progress = {},
+                    std::size_t progress_interval = 4096);
+
 using pathfind_algo = pathfind_result(std::stop_token token,
                                       const osm_graph &graph, id_t start,
-                                      id_t end);
+                                      id_t end, const search_limits &limits);
 pathfind_algo dfs, bfs, befs, ucs, a_star;
+// memory-bounded A*. IDA* keeps only the current path and, within half of
+// `limits.max_memory`, the best distance seen per node; it repeats depth-first
+// searches under a growing bound on the estimate. SMA* keeps a search tree
+// within `limits.max_memory` by forgetting the leaves with the highest
+// estimates, backing their estimates up to the parent to regenerate them
+// later. both are optimal when the memory holds the shortest path and pay for
+// less memory with expanding nodes again. they count their own containers
+// against the limit and stop when even the current path no longer fits.
+pathfind_algo ida_star, sma_star;
+
+// `ucs` with its labels in a reusable dense tree instead of maps allocated per
+// query. `mem_stat` counts the part of the tree the query used.
+pathfind_result ucs(std::stop_token token, const osm_graph &graph, id_t start,
+                    id_t end, const search_limits &limits,
+                    shortest_path_tree &workspace);
+
+// A* that only takes the arcs flagged for the region of `end`, on the graph
+// the flags were computed for
+pathfind_result arc_flags_search(std::stop_token token, const arc_flags &flags,
+                                 id_t start, id_t end,
+                                 const search_limits &limits = {});
+
+// whether a search may take the k-th arc of `tail`
+using arc_filter = std::function<bool(osm_graph::index_t tail, std::size_t k)>;
+
+// A* on the exact distances `to_end` of every node to `end`, such as a reverse
+// tree rooted there, taking only the arcs `allowed` lets through. finds no
+// path if none is shorter than `bound`.
+pathfind_result guided_search(std::stop_token token, const osm_graph &graph,
+                              id_t start, id_t end,
+                              const search_limits &limits,
+                              const std::vector<double> &to_end,
+                              const arc_filter &allowed, double bound);
+
+constexpr std::array<pathfind_algo *, 7> algorithms{
+    dfs, bfs, befs, ucs, a_star, ida_star, sma_star};
+
+// the same searches as coroutines. the limits are copied into the task, the
+// graph has to outlive it.
+using pathfind_stepper = search_task(std::stop_token token,
+                                     const osm_graph &graph, id_t start,
+                                     id_t end, search_limits limits);
+pathfind_stepper dfs_steps, bfs_steps, befs_steps, ucs_steps, a_star_steps,
+    ida_star_steps, sma_star_steps;
 
-constexpr std::array<pathfind_algo *, 5> algorithms{dfs, bfs, befs, ucs,
-                                                    a_star};
+// in the order of `algorithms`
+constexpr std::array<pathfind_stepper *, algorithms.size()> steppers{
+    dfs_steps,    bfs_steps,      befs_steps,    ucs_steps,
+    a_star_steps, ida_star_steps, sma_star_steps};
 
 } // namespace mapapp
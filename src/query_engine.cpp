@@ -0,0 +1,56 @@
+#include "query_engine.hpp"
+
+#include <atomic>
+#include <latch>
+
+namespace mapapp {
+query_engine::query_engine(const osm_graph &graph, std::size_t num_threads)
+    : graph{graph}, workspaces(num_threads), pool{num_threads} {}
+
+batch_result query_engine::run(std::span<const query_job> jobs,
+                               const search_limits &limits,
+                               std::stop_token token) {
+  using clock = std::chrono::high_resolution_clock;
+
+  batch_result batch;
+  batch.results.resize(jobs.size());
+  batch.stats.num_threads = size();
+  batch.stats.num_queries = jobs.size();
+
+  // one task per worker, each with its own workspace, pulling jobs until none
+  // are left so that long queries do not hold up a fixed share of the batch
+  std::atomic<std::size_t> next_job{0};
+  std::latch done{static_cast<std::ptrdiff_t>(workspaces.size())};
+  auto submit_time = clock::now();
+  for (auto &ws : workspaces) {
+    pool.submit([&](std::stop_token) {
+      for (std::size_t i; (i = next_job.fetch_add(1)) < jobs.size();) {
+        const auto &job = jobs[i];
+        auto start_time = clock::now();
+        auto algorithm = algorithms[job.algorithm];
+        pathfind_result result;
+        {
+          search_arena::scope scope{ws.arena};
+          result =
+              algorithm == static_cast<pathfind_algo *>(ucs)
+                  ? ucs(token, graph, job.start, job.end, limits, ws.tree)
+                  : algorithm(token, graph, job.start, job.end, limits);
+        }
+        ws.arena.reset();
+        result.submit_time = submit_time;
+        result.start_time = start_time;
+        result.finish_time = clock::now();
+        batch.results[i] = std::move(result);
+      }
+      done.count_down();
+    });
+  }
+  done.wait();
+  batch.stats.wall_time = clock::now() - submit_time;
+
+  for (const auto &result : batch.results) {
+    batch.stats.busy_time += result.execution_time();
+  }
+  return batch;
+}
+} // namespace mapapp
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "pathfind.hpp"
+#include "thread_pool.hpp"
+#include <chrono>
+#include <span>
+#include <stop_token>
+#include <vector>
+
+namespace mapapp {
+struct query_job {
+  // index into `algorithms`
+  std::size_t algorithm;
+  osm_graph::index_t start, end;
+};
+
+struct batch_statistics {
+  std::size_t num_threads = 0, num_queries = 0;
+  std::chrono::nanoseconds wall_time{0};
+  // sum of the execution times of all queries
+  std::chrono::nanoseconds busy_time{0};
+
+  double queries_per_second() const {
+    return num_queries / std::chrono::duration<double>(wall_time).count();
+  }
+  // fraction of the workers' time spent inside queries
+  double utilization() const {
+    return std::chrono::duration<double>(busy_time) /
+           (std::chrono::duration<double>(wall_time) * num_threads);
+  }
+};
+
+struct batch_result {
+  // in job order
+  std::vector<pathfind_result> results;
+  batch_statistics stats;
+};
+
+// runs batches of independent queries on a fixed set of workers. all of them
+// read the same graph; everything a query writes is either its own result or
+// the workspace of the worker running it.
+class query_engine {
+public:
+  explicit query_engine(const osm_graph &graph,
+                        std::size_t num_threads = thread_pool::default_size());
+
+  std::size_t size() const { return pool.size(); }
+
+  // blocks until every job has run. jobs still running or not yet started
+  // when `token` is triggered, and jobs out of `limits`, return without a
+  // path. not reentrant: one batch at a time owns the workspaces.
+  batch_result run(std::span<const query_job> jobs,
+                   const search_limits &limits = {},
+                   std::stop_token token = {});
+
+private:
+  struct workspace {
+    shortest_path_tree tree;
+    // backs the containers of every query, reset in between
+    search_arena arena;
+  };
+
+  const osm_graph &graph;
+  std::vector<workspace> workspaces;
+  // declared last so that the workers are joined before the workspaces go
+  thread_pool pool;
+};
+} // namespace mapapp
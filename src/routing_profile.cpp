@@ -0,0 +1,21 @@
+#include "routing_profile.hpp"
+
+#include <algorithm>
+
+namespace mapapp {
+double routing_profile::way_speed(const highway &way) const {
+  bool allowed = p_mode == mode::MOTOR_VEHICLE ? way.motor_vehicle
+                 : p_mode == mode::BICYCLE     ? way.bicycle
+                                               : way.foot;
+  // links are as fast as the road they lead to
+  auto s = speed[static_cast<std::size_t>(way.road_kind)];
+  if (!allowed || s <= 0.0) {
+    return 0.0;
+  }
+  if (way.maxspeed > 0.0f) {
+    s = p_mode == mode::MOTOR_VEHICLE ? way.maxspeed
+                                      : std::min<double>(s, way.maxspeed);
+  }
+  return std::min(s, max_speed);
+}
+} // namespace mapapp
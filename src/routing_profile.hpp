@@ -0,0 +1,53 @@
+#pragma once
+
+#include "map_loader.hpp"
+#include <array>
+#include <cstddef>
+
+namespace mapapp {
+// how a graph built for a profile weighs its arcs: by the seconds it takes
+// to travel them instead of their length. ways the profile may not use are
+// left out of it.
+struct routing_profile {
+  enum class mode {
+    MOTOR_VEHICLE,
+    BICYCLE,
+    FOOT,
+  };
+  static constexpr auto num_kinds =
+      static_cast<std::size_t>(highway::kind::NUM_KINDS);
+
+  const char *name;
+  mode p_mode;
+  // km/h on each kind of highway, 0 if the profile may not use it
+  std::array<double, num_kinds> speed;
+  // km/h, no arc is travelled faster. it caps maxspeed tags, so that straight
+  // line distance at this speed never overestimates a travel time.
+  double max_speed;
+
+  // pedestrians walk both ways of one-way streets and turn as they please
+  bool obeys_oneway() const { return p_mode != mode::FOOT; }
+  bool obeys_restrictions() const { return p_mode != mode::FOOT; }
+
+  // km/h along `way`, 0 if the profile may not use it. a maxspeed tag sets the
+  // speed of motor vehicles and caps that of the others.
+  double way_speed(const highway &way) const;
+};
+
+// MOTORWAY, TRUNK, PRIMARY, SECONDARY, TERTIARY, RESIDENTIAL, SERVICE, PATH,
+// OTHER
+constexpr std::array<routing_profile, 3> profiles{
+    routing_profile{"Ô tô",
+                    routing_profile::mode::MOTOR_VEHICLE,
+                    {100, 80, 60, 50, 40, 30, 15, 0, 25},
+                    130},
+    routing_profile{"Xe đạp",
+                    routing_profile::mode::BICYCLE,
+                    {0, 16, 16, 16, 16, 16, 14, 12, 14},
+                    16},
+    routing_profile{"Đi bộ",
+                    routing_profile::mode::FOOT,
+                    {0, 5, 5, 5, 5, 5, 5, 5, 5},
+                    5},
+};
+} // namespace mapapp
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <span>
+#include <vector>
+
+namespace mapapp {
+// bounded single-producer single-consumer queue. neither side blocks or locks:
+// each only writes its own index and reads the other's.
+template <class T> class spsc_ring {
+public:
+  // rounded up to a power of two
+  explicit spsc_ring(std::size_t capacity)
+      : slots(std::bit_ceil(std::max<std::size_t>(capacity, 1))),
+        mask{slots.size() - 1} {}
+
+  // producer side: pushes as many of `items` as fit, returns how many
+  std::size_t push(std::span<const T> items) {
+    auto t = tail.load(std::memory_order_relaxed);
+    auto h = head.load(std::memory_order_acquire);
+    auto n = std::min(items.size(), slots.size() - (t - h));
+    for (std::size_t i = 0; i < n; ++i) {
+      slots[(t + i) & mask] = items[i];
+    }
+    tail.store(t + n, std::memory_order_release);
+    return n;
+  }
+
+  // consumer side: pops up to `out.size()` items, returns how many
+  std::size_t pop(std::span<T> out) {
+    auto h = head.load(std::memory_order_relaxed);
+    auto t = tail.load(std::memory_order_acquire);
+    auto n = std::min(out.size(), t - h);
+    for (std::size_t i = 0; i < n; ++i) {
+      out[i] = slots[(h + i) & mask];
+    }
+    head.store(h + n, std::memory_order_release);
+    return n;
+  }
+
+private:
+  std::vector<T> slots;
+  std::size_t mask;
+  // next slot to read, written by the consumer
+  alignas(64) std::atomic<std::size_t> head{0};
+  // next slot to write, written by the producer
+  alignas(64) std::atomic<std::size_t> tail{0};
+};
+} // namespace mapapp
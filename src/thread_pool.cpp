@@ -0,0 +1,48 @@
+#include "thread_pool.hpp"
+
+namespace mapapp {
+thread_pool::thread_pool(std::size_t num_threads) {
+  workers.reserve(num_threads);
+  for (std::size_t i = 0; i < num_threads; ++i) {
+    workers.emplace_back([this](std::stop_token token) { work(token); });
+  }
+}
+
+thread_pool::~thread_pool() {
+  // stop every worker before joining the first one, so that none of them
+  // picks up another task in the meantime
+  for (auto &worker : workers) {
+    worker.request_stop();
+  }
+}
+
+std::stop_source thread_pool::submit(task_fn fn) {
+  std::stop_source stop;
+  {
+    std::scoped_lock lock{mtx};
+    tasks.push_back({std::move(fn), stop});
+  }
+  cv.notify_one();
+  return stop;
+}
+
+void thread_pool::work(std::stop_token token) {
+  while (true) {
+    task t;
+    {
+      std::unique_lock lock{mtx};
+      if (!cv.wait(lock, token, [&] { return !tasks.empty(); })) {
+        return;
+      }
+      t = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    if (t.stop.stop_requested()) {
+      continue;
+    }
+    // shutting down the pool cancels the running task as well
+    std::stop_callback forward{token, [&] { t.stop.request_stop(); }};
+    t.fn(t.stop.get_token());
+  }
+}
+} // namespace mapapp
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace mapapp {
+// fixed set of workers running tasks in submission order. every task gets its
+// own stop token, which is also triggered when the pool shuts down.
+class thread_pool {
+public:
+  using task_fn = std::function<void(std::stop_token)>;
+
+  explicit thread_pool(std::size_t num_threads = default_size());
+  ~thread_pool();
+  thread_pool(const thread_pool &) = delete;
+  thread_pool(thread_pool &&) = delete;
+  auto operator=(const thread_pool &) = delete;
+  auto operator=(thread_pool &&) = delete;
+
+  // the returned source cancels the task, whether queued or running
+  std::stop_source submit(task_fn fn);
+  std::size_t size() const { return workers.size(); }
+
+  static std::size_t default_size() {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+private:
+  struct task {
+    task_fn fn;
+    std::stop_source stop;
+  };
+
+  std::mutex mtx;
+  std::condition_variable_any cv;
+  std::deque<task> tasks;
+  // declared last so that the workers are joined before the queue goes away
+  std::vector<std::jthread> workers;
+
+  void work(std::stop_token token);
+};
+} // namespace mapapp
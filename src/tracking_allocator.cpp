@@ -0,0 +1,82 @@
+#include "tracking_allocator.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace mapapp {
+namespace {
+thread_local std::pmr::memory_resource *current_resource =
+    std::pmr::new_delete_resource();
+} // namespace
+
+void memory_statistics::new_block() {
+  max_allocated = (cur_allocated + block_size - 1) / block_size * block_size;
+}
+
+search_arena::scope::scope(search_arena &arena) : previous{current_resource} {
+  current_resource = &arena;
+}
+
+search_arena::scope::~scope() { current_resource = previous; }
+
+search_arena::search_arena(std::size_t chunk_size) : chunk_size{chunk_size} {}
+
+void search_arena::reset() {
+  next_chunk = 0;
+  cursor = limit = nullptr;
+  free_blocks.fill(nullptr);
+}
+
+void *search_arena::do_allocate(std::size_t bytes, std::size_t alignment) {
+  auto small = bytes <= size_class * num_size_classes &&
+               alignment <= alignof(std::max_align_t);
+  if (small) {
+    // small blocks are handed out in whole size classes so that any freed
+    // block of a class fits every later request of it
+    auto cls = (std::max(bytes, std::size_t{1}) - 1) / size_class;
+    if (auto block = free_blocks[cls]) {
+      free_blocks[cls] = block->next;
+      return block;
+    }
+    bytes = (cls + 1) * size_class;
+    alignment = alignof(std::max_align_t);
+  }
+
+  auto align = [&] {
+    auto address = reinterpret_cast<std::uintptr_t>(cursor);
+    return cursor + ((alignment - address % alignment) % alignment);
+  };
+  auto start = align();
+  while (cursor == nullptr || start + bytes > limit) {
+    // skip chunks that are too small, they are used again after a reset
+    while (next_chunk < chunks.size() &&
+           chunks[next_chunk].second < bytes + alignment) {
+      ++next_chunk;
+    }
+    if (next_chunk == chunks.size()) {
+      auto size = std::max(chunk_size, bytes + alignment);
+      chunks.emplace_back(std::make_unique_for_overwrite<std::byte[]>(size),
+                          size);
+    }
+    auto &[data, size] = chunks[next_chunk++];
+    cursor = data.get();
+    limit = cursor + size;
+    start = align();
+  }
+  cursor = start + bytes;
+  return start;
+}
+
+void search_arena::do_deallocate(void *p, std::size_t bytes,
+                                 std::size_t alignment) {
+  // larger blocks stay allocated until the next reset
+  if (bytes <= size_class * num_size_classes &&
+      alignment <= alignof(std::max_align_t)) {
+    auto cls = (std::max(bytes, std::size_t{1}) - 1) / size_class;
+    free_blocks[cls] = new (p) free_block{free_blocks[cls]};
+  }
+}
+
+std::pmr::memory_resource *search_resource() { return current_resource; }
+} // namespace mapapp
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <set>
+#include <vector>
+
+// per-query accounting can be compiled out entirely, leaving the pf_* containers
+// as plain std containers with a pointer per allocator
+#ifndef MAPAPP_MEMORY_STATS
+#define MAPAPP_MEMORY_STATS 1
+#endif
+
+namespace mapapp {
+// bytes currently allocated and allocated in total are exact. the high-water
+// mark is kept in whole blocks, so it is only written when an allocation
+// crosses into a new block.
+struct memory_statistics {
+  static constexpr bool enabled = MAPAPP_MEMORY_STATS;
+  static constexpr std::size_t block_size = 4096;
+
+  std::size_t total_allocated = 0;
+  // rounded up to a multiple of `block_size`
+  std::size_t max_allocated = 0;
+  std::size_t cur_allocated = 0;
+  std::size_t num_allocations = 0;
+
+  void alloc(std::size_t size) {
+    if constexpr (enabled) {
+      ++num_allocations;
+      total_allocated += size;
+      cur_allocated += size;
+      if (cur_allocated > max_allocated) {
+        new_block();
+      }
+    }
+  }
+
+  void free(std::size_t size) {
+    if constexpr (enabled) {
+      assert(size <= cur_allocated);
+      cur_allocated -= size;
+    }
+  }
+
+private:
+  void new_block();
+};
+
+// bump allocator for the containers of a query. memory comes from chunks that
+// are kept when the arena is reset, and small freed blocks (map and set nodes)
+// are recycled by size, so once warmed up a query allocates nothing from the
+// system. single threaded: one arena per worker.
+class search_arena : public std::pmr::memory_resource {
+public:
+  static constexpr std::size_t default_chunk_size = std::size_t{1} << 16;
+
+  // while alive, every tracking_allocator created on this thread allocates from
+  // `arena`
+  class scope {
+  public:
+    explicit scope(search_arena &arena);
+    ~scope();
+    scope(const scope &) = delete;
+    auto operator=(const scope &) = delete;
+
+  private:
+    std::pmr::memory_resource *previous;
+  };
+
+  explicit search_arena(std::size_t chunk_size = default_chunk_size);
+  search_arena(const search_arena &) = delete;
+  auto operator=(const search_arena &) = delete;
+
+  // makes all chunks available again, nothing allocated from the arena may be
+  // used afterwards
+  void reset();
+  // chunks requested from the system since construction
+  std::size_t num_chunks() const { return chunks.size(); }
+
+private:
+  static constexpr std::size_t size_class = 16, num_size_classes = 16;
+
+  struct free_block {
+    free_block *next;
+  };
+
+  std::size_t chunk_size;
+  std::vector<std::pair<std::unique_ptr<std::byte[]>, std::size_t>> chunks;
+  std::size_t next_chunk = 0;
+  std::byte *cursor = nullptr, *limit = nullptr;
+  std::array<free_block *, num_size_classes> free_blocks{};
+
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+  void do_deallocate(void *p, std::size_t bytes,
+                     std::size_t alignment) override;
+  bool do_is_equal(const memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+// the arena of the innermost live `search_arena::scope` on this thread, or the
+// global heap
+std::pmr::memory_resource *search_resource();
+
+template <class T> struct tracking_allocator {
+  using value_type = T;
+
+  memory_statistics *stats;
+  std::pmr::memory_resource *resource;
+
+  tracking_allocator(memory_statistics *stats)
+      : stats{stats}, resource{search_resource()} {}
+  tracking_allocator(const tracking_allocator &other)
+      : stats{other.stats}, resource{other.resource} {}
+  template <class U>
+  tracking_allocator(const tracking_allocator<U> &other)
+      : stats{other.stats}, resource{other.resource} {}
+
+  [[nodiscard]] T *allocate(std::size_t n, const void * = 0) {
+    auto ptr =
+        static_cast<T *>(resource->allocate(n * sizeof(T), alignof(T)));
+    stats->alloc(n * sizeof(T));
+    return ptr;
+  }
+
+  void deallocate(T *p, std::size_t n) {
+    resource->deallocate(p, n * sizeof(T), alignof(T));
+    stats->free(n * sizeof(T));
+  }
+};
+
+template <class T> using pf_vector = std::vector<T, tracking_allocator<T>>;
+
+template <class K, class V>
+using pf_map =
+    std::map<K, V, std::less<K>,
+             tracking_allocator<typename std::map<K, V>::value_type>>;
+
+template <class K>
+using pf_set = std::set<K, std::less<K>,
+                        tracking_allocator<typename std::set<K>::value_type>>;
+
+template <class T> using pf_deque = std::deque<T, tracking_allocator<T>>;
+} // namespace mapapp
@@ -0,0 +1,179 @@
+#include "transit_node_routing.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+namespace mapapp {
+namespace {
+using index_t = osm_graph::index_t;
+constexpr auto infinity = std::numeric_limits<double>::infinity();
+
+// runs `work` on `num_threads` threads, the calling one included
+void run_workers(std::size_t num_threads, const auto &work) {
+  std::vector<std::jthread> helpers;
+  for (std::size_t id = 1; id < num_threads; ++id) {
+    helpers.emplace_back(work);
+  }
+  work();
+}
+} // namespace
+
+transit_node_routing::transit_node_routing(const osm_graph &graph,
+                                           const contraction_hierarchy &ch,
+                                           std::size_t num_transit,
+                                           std::size_t num_threads)
+    : graph{graph}, ch{ch}, num_transit{std::min(num_transit, ch.size())} {
+  const auto n = ch.size();
+  const auto k = this->num_transit;
+  // rank of transit node 0
+  const auto first_transit = n - k;
+  num_threads = std::max<std::size_t>(num_threads, 1);
+
+  // a row is PHAST on the transit nodes alone: the upward search from a
+  // transit node and the downward sweep to another one never leave the top
+  // of the hierarchy
+  table.resize(k * k);
+  std::atomic<std::size_t> cursor{0};
+  run_workers(num_threads, [&] {
+    std::vector<std::pair<double, index_t>> queue;
+    for (std::size_t i; (i = cursor++) < k;) {
+      auto row = table.begin() + i * k;
+      std::fill(row, row + k, infinity);
+      row[i] = 0.0;
+      queue.emplace_back(0.0, first_transit + i);
+      while (!queue.empty()) {
+        std::pop_heap(queue.begin(), queue.end(), std::greater<>{});
+        auto [d, r] = queue.back();
+        queue.pop_back();
+        if (d > row[r - first_transit]) {
+          continue;
+        }
+        for (const auto &arc : ch.up(r)) {
+          auto &label = row[arc.head - first_transit];
+          if (auto next = d + arc.weight; next < label) {
+            label = next;
+            queue.emplace_back(next, arc.head);
+            std::push_heap(queue.begin(), queue.end(), std::greater<>{});
+          }
+        }
+      }
+      for (auto r = n; r-- > first_transit;) {
+        auto &dist = row[r - first_transit];
+        for (const auto &arc : ch.down(r)) {
+          dist = std::min(dist, row[arc.head - first_transit] + arc.weight);
+        }
+      }
+    }
+  });
+
+  // the upward search of every node stops at transit nodes, those it meets
+  // are its access nodes. one is dropped if another one and the table reach
+  // it no later, ties to the lower index, since any path through it may pass
+  // the other one instead.
+  std::array<std::vector<std::vector<access_node>>, 2> found;
+  for (std::size_t s = 0; s < 2; ++s) {
+    found[s].resize(graph.nodes.size());
+    search_space[s].resize(graph.nodes.size());
+  }
+  cursor = 0;
+  run_workers(num_threads, [&] {
+    // reset to infinity after each search
+    std::vector<double> dist(n, infinity);
+    std::vector<index_t> touched;
+    std::vector<std::pair<double, index_t>> queue;
+    std::vector<access_node> candidates;
+    for (index_t v; (v = cursor++) < graph.nodes.size();) {
+      for (std::size_t s = 0; s < 2; ++s) {
+        auto &space = search_space[s][v];
+        auto root = ch.rank[v];
+        dist[root] = 0.0;
+        touched.push_back(root);
+        queue.emplace_back(0.0, root);
+        while (!queue.empty()) {
+          std::pop_heap(queue.begin(), queue.end(), std::greater<>{});
+          auto [d, r] = queue.back();
+          queue.pop_back();
+          if (d > dist[r]) {
+            continue;
+          }
+          if (r >= first_transit) {
+            candidates.push_back(
+                {static_cast<transit_t>(r - first_transit), d});
+            continue;
+          }
+          space.add(graph.nodes[ch.node[r]].position);
+          for (const auto &arc : s == 0 ? ch.up(r) : ch.down(r)) {
+            if (auto next = d + arc.weight; next < dist[arc.head]) {
+              if (dist[arc.head] == infinity) {
+                touched.push_back(arc.head);
+              }
+              dist[arc.head] = next;
+              queue.emplace_back(next, arc.head);
+              std::push_heap(queue.begin(), queue.end(), std::greater<>{});
+            }
+          }
+        }
+        for (auto r : touched) {
+          dist[r] = infinity;
+        }
+        touched.clear();
+
+        for (const auto &a : candidates) {
+          auto dominated = std::any_of(
+              candidates.begin(), candidates.end(), [&](const auto &other) {
+                if (other.transit == a.transit) {
+                  return false;
+                }
+                auto via = other.distance +
+                           (s == 0 ? table[other.transit * k + a.transit]
+                                   : table[a.transit * k + other.transit]);
+                return via < a.distance ||
+                       (via == a.distance && other.transit < a.transit);
+              });
+          if (!dominated) {
+            found[s][v].push_back(a);
+          }
+        }
+        candidates.clear();
+      }
+    }
+  });
+
+  for (std::size_t s = 0; s < 2; ++s) {
+    access_first[s].reserve(graph.nodes.size() + 1);
+    access_first[s].push_back(0);
+    for (auto &nodes : found[s]) {
+      access[s].insert(access[s].end(), nodes.begin(), nodes.end());
+      access_first[s].push_back(access[s].size());
+      nodes = {};
+    }
+  }
+}
+
+double transit_node_routing::distance(index_t start, index_t end) const {
+  if (local(start, end)) {
+    auto result = ch.query(std::stop_token{}, start, end);
+    return result ? result.distance : infinity;
+  }
+  auto best = infinity;
+  for (const auto &a : forward(start)) {
+    const auto *row = &table[a.transit * num_transit];
+    for (const auto &b : backward(end)) {
+      best = std::min(best, a.distance + row[b.transit] + b.distance);
+    }
+  }
+  return best;
+}
+
+std::size_t transit_node_routing::bytes() const {
+  auto total = table.size() * sizeof(double);
+  for (std::size_t s = 0; s < 2; ++s) {
+    total += access_first[s].size() * sizeof(std::size_t) +
+             access[s].size() * sizeof(access_node) +
+             search_space[s].size() * sizeof(box);
+  }
+  return total;
+}
+} // namespace mapapp
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "contraction.hpp"
+#include "pathfind.hpp"
+#include "thread_pool.hpp"
+#include <array>
+#include <cstdint>
+#include <glm/common.hpp>
+#include <glm/vec2.hpp>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace mapapp {
+// transit node routing (Bast, Funke, Sanders & Schultes; on a contraction
+// hierarchy as by Arz, Luxen & Sanders). the highest ranks of the hierarchy
+// are transit nodes, with a table of the distances between all of them. the
+// access nodes of a node are the first transit nodes its upward search
+// meets. a long path climbs past them, so its length is the best sum of an
+// access distance at each end and a table entry, without any search.
+//
+// this is exact only if the highest node of a shortest path is a transit
+// node. it is, unless the upward search spaces of `start` and `end` below
+// the transit nodes share a node; those overlap only if their bounding boxes
+// do, and such local queries fall back to the hierarchy's own query.
+struct transit_node_routing {
+  using index_t = osm_graph::index_t;
+  using transit_t = std::uint32_t;
+
+  struct access_node {
+    // among the transit nodes, the one of rank `ch.size() - num_transit + i`
+    // is transit node i
+    transit_t transit;
+    double distance;
+  };
+
+  // empty unless something was added
+  struct box {
+    glm::vec2 min{std::numeric_limits<float>::infinity()};
+    glm::vec2 max{-std::numeric_limits<float>::infinity()};
+
+    void add(glm::vec2 point) {
+      min = glm::min(min, point);
+      max = glm::max(max, point);
+    }
+    bool intersects(const box &other) const {
+      return min.x <= other.max.x && other.min.x <= max.x &&
+             min.y <= other.max.y && other.min.y <= max.y;
+    }
+  };
+
+  const osm_graph &graph;
+  const contraction_hierarchy &ch;
+  std::size_t num_transit;
+  // from transit node i to transit node j at i * num_transit + j
+  std::vector<double> table;
+  // forward, then backward: the access nodes of node v in
+  // [access_first[v], access_first[v + 1]) of `access`, and the bounding box
+  // of the nodes its upward search settles below the transit nodes
+  std::array<std::vector<std::size_t>, 2> access_first;
+  std::array<std::vector<access_node>, 2> access;
+  std::array<std::vector<box>, 2> search_space;
+
+  // the `num_transit` highest ranks become transit nodes. the rows of the
+  // table and then the access nodes are split among `num_threads` workers,
+  // the calling thread is one of them.
+  transit_node_routing(const osm_graph &graph, const contraction_hierarchy &ch,
+                       std::size_t num_transit = 1024,
+                       std::size_t num_threads = thread_pool::default_size());
+  transit_node_routing(const transit_node_routing &) = delete;
+  auto operator=(const transit_node_routing &) = delete;
+
+  std::span<const access_node> forward(index_t node) const {
+    return get(0, node);
+  }
+  std::span<const access_node> backward(index_t node) const {
+    return get(1, node);
+  }
+
+  // if the table may miss the shortest path from `start` to `end`
+  bool local(index_t start, index_t end) const {
+    return search_space[0][start].intersects(search_space[1][end]);
+  }
+
+  // length of a shortest path from `start` to `end`, infinity if there is
+  // none. local queries run `ch.query`.
+  double distance(index_t start, index_t end) const;
+
+  // size of the table, the access nodes and the boxes
+  std::size_t bytes() const;
+
+private:
+  std::span<const access_node> get(std::size_t s, index_t node) const {
+    return {access[s].data() + access_first[s][node],
+            access[s].data() + access_first[s][node + 1]};
+  }
+};
+} // namespace mapapp